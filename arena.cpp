@@ -0,0 +1,51 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+// Обычный указатель, а не shared_ptr: доступ к такой thread_local переменной
+// не требует проверки инициализации. Арену удерживает ArenaScope
+thread_local Arena* current_arena = nullptr;
+}  // namespace
+
+void* Arena::AllocateInNewBlock(size_t size) {
+    // Память из new[] выровнена по max_align_t, поэтому начало блока выравнивать не нужно
+    const size_t growth = min(initial_block_size_ << min(blocks_.size(), size_t{16}), MAX_BLOCK_SIZE);
+    const size_t block_size = max(growth, size);
+    blocks_.push_back({unique_ptr<byte[]>(new byte[block_size]), block_size});
+    reserved_ += block_size;
+
+    byte* result = blocks_.back().data.get();
+    current_ = result + size;
+    end_ = result + block_size;
+    allocated_ += size;
+    return result;
+}
+
+size_t Arena::GetAllocatedBytes() const {
+    return allocated_;
+}
+
+size_t Arena::GetReservedBytes() const {
+    return reserved_;
+}
+
+ArenaScope::ArenaScope(shared_ptr<Arena> arena)
+    : arena_(move(arena))
+    , previous_(exchange(current_arena, arena_.get())) {
+}
+
+ArenaScope::~ArenaScope() {
+    current_arena = previous_;
+}
+
+Arena* ArenaScope::Current() {
+    return current_arena;
+}
+
+}  // namespace ast
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ast {
+
+// Арена: выделяет память из больших блоков подряд и освобождает её целиком
+// при разрушении. Отдельные выделения не освобождаются.
+// Размер блоков растёт вдвое, поэтому даже у большой программы их немного
+class Arena : public std::enable_shared_from_this<Arena> {
+public:
+    static constexpr size_t INITIAL_BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_BLOCK_SIZE = 16 * 1024 * 1024;
+
+    Arena() = default;
+    // Арена для небольших программ: первый блок размером initial_block_size
+    explicit Arena(size_t initial_block_size)
+        : initial_block_size_(initial_block_size) {
+    }
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Возвращает size байт, выровненных по align (степень двойки, не больше alignof(max_align_t))
+    void* Allocate(size_t size, size_t align) {
+        const auto address = reinterpret_cast<std::uintptr_t>(current_);
+        const std::uintptr_t aligned = (address + align - 1) & ~(std::uintptr_t{align} - 1);
+        if (current_ != nullptr && aligned + size <= reinterpret_cast<std::uintptr_t>(end_)) {
+            current_ = reinterpret_cast<std::byte*>(aligned + size);
+            allocated_ += size;
+            return reinterpret_cast<void*>(aligned);
+        }
+        return AllocateInNewBlock(size);
+    }
+
+    // Возвращает true, если ptr указывает в память арены
+    [[nodiscard]] bool Contains(const void* ptr) const {
+        const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        // Чаще всего удаляются узлы из последних, самых больших блоков
+        for (auto it = blocks_.rbegin(); it != blocks_.rend(); ++it) {
+            const auto begin = reinterpret_cast<std::uintptr_t>(it->data.get());
+            if (address >= begin && address - begin < it->size) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Сколько байт выдано через Allocate
+    [[nodiscard]] size_t GetAllocatedBytes() const;
+    // Сколько байт занимают блоки арены
+    [[nodiscard]] size_t GetReservedBytes() const;
+
+private:
+    void* AllocateInNewBlock(size_t size);
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks_;
+    std::byte* current_ = nullptr;
+    std::byte* end_ = nullptr;
+    size_t initial_block_size_ = INITIAL_BLOCK_SIZE;
+    size_t allocated_ = 0;
+    size_t reserved_ = 0;
+};
+
+// Пока объект ArenaScope существует, узлы AST, создаваемые в этом потоке,
+// размещаются в арене arena, а удаление узлов из этой арены не освобождает память.
+// Области могут быть вложенными
+class ArenaScope {
+public:
+    explicit ArenaScope(std::shared_ptr<Arena> arena);
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+    ~ArenaScope();
+
+    // Арена текущей области либо nullptr, если узлы размещаются в куче
+    static Arena* Current();
+
+private:
+    std::shared_ptr<Arena> arena_;
+    Arena* previous_;
+};
+
+}  // namespace ast
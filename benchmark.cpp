@@ -0,0 +1,783 @@
+#include "lexer.h"
+#include "log_duration.h"
+#include "parse.h"
+#include "program_cache.h"
+#include "runtime.h"
+#include "statement.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Количество вызовов operator new с момента запуска
+atomic<size_t> allocation_count{0};
+
+// Общая часть всех замен operator new. Выравнивание больше стандартного
+// выделяется через aligned_alloc, остальное - через malloc, поэтому любую
+// форму operator delete можно реализовать через free
+void* CountedAlloc(size_t size, size_t alignment = alignof(max_align_t)) noexcept {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment <= alignof(max_align_t)) {
+        return malloc(size);
+    }
+    // Размер для aligned_alloc должен быть кратен выравниванию
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* CountedAllocOrThrow(size_t size, size_t alignment = alignof(max_align_t)) {
+    if (void* ptr = CountedAlloc(size, alignment)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+}  // namespace
+
+// Заменены все формы operator new и operator delete, чтобы каждая пара
+// выделения и освобождения проходила через один и тот же распределитель
+void* operator new(size_t size) {
+    return CountedAllocOrThrow(size);
+}
+
+void* operator new[](size_t size) {
+    return CountedAllocOrThrow(size);
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    return CountedAllocOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    return CountedAllocOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, const nothrow_t& /*tag*/) noexcept {
+    return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const nothrow_t& /*tag*/) noexcept {
+    return CountedAlloc(size);
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t& /*tag*/) noexcept {
+    return CountedAlloc(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t& /*tag*/) noexcept {
+    return CountedAlloc(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t /*size*/) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, align_val_t /*alignment*/) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t /*alignment*/) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/, align_val_t /*alignment*/) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t /*size*/, align_val_t /*alignment*/) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, const nothrow_t& /*tag*/) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const nothrow_t& /*tag*/) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, align_val_t /*alignment*/, const nothrow_t& /*tag*/) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t /*alignment*/, const nothrow_t& /*tag*/) noexcept {
+    free(ptr);
+}
+
+namespace {
+
+// Скрипт с большим количеством арифметики и сравнений: рекурсивный метод
+// глубины depth вызывается calls раз из верхнего уровня программы
+string MakeArithmeticScript(int depth, int calls) {
+    ostringstream script;
+    script << R"(
+class Calc:
+  def run(n, acc):
+    if n == 0:
+      return acc
+    if n / 2 * 2 == n:
+      return self.run(n - 1, acc + n * 3 - n / 4)
+    return self.run(n - 1, acc - n + 7 * 2)
+
+calc = Calc()
+total = 0
+)";
+    for (int i = 0; i < calls; ++i) {
+        script << "total = total + calc.run("s << depth << ", "s << i << ") - total / 2\n"s;
+    }
+    script << "print total\n"s;
+    return script.str();
+}
+
+// Скрипт, который создаёт много маленьких объектов и читает их поля
+string MakeFieldsScript(int depth, int calls) {
+    ostringstream script;
+    script << R"(
+class Point:
+  def __init__(x, y, z):
+    self.x = x
+    self.y = y
+    self.z = z
+
+class Walk:
+  def run(n, p):
+    if n == 0:
+      return p.x + p.y + p.z
+    q = Point(p.y, p.z, p.x + n)
+    return self.run(n - 1, q)
+
+walk = Walk()
+total = 0
+)";
+    for (int i = 0; i < calls; ++i) {
+        script << "total = walk.run("s << depth << ", Point(" << i << ", 1, 2)) - total\n"s;
+    }
+    script << "print total\n"s;
+    return script.str();
+}
+
+// Скрипт с константными подвыражениями и унарным минусом, которые сворачивает FoldConstants
+string MakeFoldingScript(int depth, int calls) {
+    ostringstream script;
+    script << R"(
+class Clock:
+  def run(n, acc):
+    if n == 0:
+      return acc
+    if 24 * 60 > 1000 and not 1 == 2:
+      return self.run(n - 1, acc + 60 * 60 * 24 / (2 + 2) - -n + -(3 * 4))
+    return -1
+
+clock = Clock()
+total = 0
+)";
+    for (int i = 0; i < calls; ++i) {
+        script << "total = clock.run("s << depth << ", -"s << i << ") - total / 2\n"s;
+    }
+    script << "print total\n"s;
+    return script.str();
+}
+
+// Скрипт, который в основном вычисляет строковые константы
+string MakeConstantsScript(int depth, int calls) {
+    ostringstream script;
+    script << R"(
+class Walk:
+  def run(n):
+    if n == 0:
+      return "done"
+    s = "literal"
+    if s == "literal" and "a" < "b" and not "x" == "y":
+      return self.run(n - 1)
+    return "broken"
+
+walk = Walk()
+)";
+    for (int i = 0; i < calls; ++i) {
+        script << "result = walk.run("s << depth << ")\n"s;
+    }
+    script << "print result\n"s;
+    return script.str();
+}
+
+// Скрипт, в котором на каждом шаге сравниваются числа и строки из переменных
+string MakeComparisonScript(int depth, int calls) {
+    ostringstream script;
+    script << R"(
+class Sort:
+  def run(n, m, s):
+    if n == 0:
+      return m
+    if n > m and n >= 1 or n <= m and not n < 0:
+      if s != "b" and s < "c" and n != m:
+        return self.run(n - 1, m + 1, s)
+    if n == m or s == "a":
+      return self.run(n - 1, m, s)
+    return -1
+
+sort = Sort()
+total = 0
+)";
+    for (int i = 0; i < calls; ++i) {
+        script << "total = sort.run("s << depth << ", "s << i % 7 << ", 'a') - total\n"s;
+    }
+    script << "print total\n"s;
+    return script.str();
+}
+
+// Сумма чисел, посчитанная циклом for либо while внутри метода
+string MakeLoopScript(const string& loop, int iterations) {
+    ostringstream script;
+    script << R"(
+class Sum:
+  def by_for(n):
+    acc = 0
+    for i in range(n):
+      acc = acc + i - acc / 2
+    return acc
+
+  def by_while(n):
+    acc = 0
+    i = 0
+    while i < n:
+      acc = acc + i - acc / 2
+      i = i + 1
+    return acc
+
+s = Sum()
+)";
+    script << "print s."s << loop << "("s << iterations << ")\n"s;
+    return script.str();
+}
+
+// Та же сумма хвостовой рекурсией глубины depth, повторённой calls раз
+string MakeRecursionScript(int depth, int calls) {
+    ostringstream script;
+    script << R"(
+class Sum:
+  def run(i, n, acc):
+    if i == n:
+      return acc
+    return self.run(i + 1, n, acc + i - acc / 2)
+
+s = Sum()
+)";
+    for (int i = 0; i < calls; ++i) {
+        script << "result = s.run(0, "s << depth << ", 0)\n"s;
+    }
+    script << "print result\n"s;
+    return script.str();
+}
+
+// Сумма нехвостовой рекурсией: каждый уровень занимает свой кадр
+string MakeDeepCallScript(int depth, int calls) {
+    ostringstream script;
+    script << R"(
+class Sum:
+  def down(n):
+    if n == 0:
+      return 0
+    return n + self.down(n - 1)
+
+s = Sum()
+)";
+    for (int i = 0; i < calls; ++i) {
+        script << "result = s.down("s << depth << ")\n"s;
+    }
+    script << "print result\n"s;
+    return script.str();
+}
+
+void RunScript(const string& script, bool use_vm, const string& label) {
+    istringstream input(script);
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+
+    ostringstream output;
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    const size_t allocations_before = allocation_count.load();
+    const auto cache_before = ast::MethodCache::GetTotalStats();
+    {
+        LOG_DURATION(label);
+        if (use_vm) {
+            vm::RunProgram(*program, closure, context);
+        } else {
+            program->Execute(closure, context);
+        }
+    }
+    cerr << "  allocations: "s << allocation_count.load() - allocations_before << endl;
+    if (!use_vm) {
+        const auto cache = ast::MethodCache::GetTotalStats();
+        cerr << "  method cache: "s << cache.hits - cache_before.hits << " hits, "s
+             << cache.misses - cache_before.misses << " misses"s << endl;
+    }
+    cerr << "  result: "s << output.str();
+}
+
+// Сравнивает проверку типа по ObjectKind с dynamic_cast на объектах в куче
+void BenchTypeDispatch() {
+    constexpr int ITERATIONS = 20'000'000;
+
+    runtime::Class cls{"Empty"s, {}, nullptr};
+    vector<runtime::ObjectHolder> objects{
+        runtime::ObjectHolder::Own(runtime::String{"str"s}),
+        runtime::ObjectHolder::Own(runtime::ClassInstance{cls}),
+        runtime::ObjectHolder::Own(runtime::String{""s}),
+    };
+
+    size_t hits = 0;
+    {
+        LOG_DURATION("type dispatch: ObjectKind"s);
+        for (int i = 0; i < ITERATIONS; ++i) {
+            const runtime::ObjectHolder& object = objects[i % objects.size()];
+            hits += object.TryAs<runtime::String>() != nullptr;
+            hits += object.TryAs<runtime::ClassInstance>() != nullptr;
+        }
+    }
+    {
+        LOG_DURATION("type dispatch: dynamic_cast"s);
+        for (int i = 0; i < ITERATIONS; ++i) {
+            runtime::Object* object = objects[i % objects.size()].Get();
+            hits += dynamic_cast<runtime::String*>(object) != nullptr;
+            hits += dynamic_cast<runtime::ClassInstance*>(object) != nullptr;
+        }
+    }
+    cerr << "  hits: "s << hits << endl;
+}
+
+void BenchArithmeticScript() {
+    const string script = MakeArithmeticScript(500, 2000);
+    RunScript(script, false, "arithmetic script: tree walking"s);
+    RunScript(script, true, "arithmetic script: vm"s);
+}
+
+void BenchFoldingScript() {
+    const string script = MakeFoldingScript(500, 2000);
+    RunScript(script, false, "folding script: tree walking"s);
+    RunScript(script, true, "folding script: vm"s);
+}
+
+void BenchComparisonScript() {
+    const string script = MakeComparisonScript(500, 1000);
+    RunScript(script, false, "comparison script: tree walking"s);
+    RunScript(script, true, "comparison script: vm"s);
+}
+
+void BenchLoops() {
+    constexpr int ITERATIONS = 1'000'000;
+    constexpr int DEPTH = 1'000;
+    const string for_script = MakeLoopScript("by_for"s, ITERATIONS);
+    const string while_script = MakeLoopScript("by_while"s, ITERATIONS);
+    const string recursion_script = MakeRecursionScript(DEPTH, ITERATIONS / DEPTH);
+    for (bool use_vm : {false, true}) {
+        const string engine = use_vm ? "vm"s : "tree walking"s;
+        RunScript(for_script, use_vm, "loops: for, "s + engine);
+        RunScript(while_script, use_vm, "loops: while, "s + engine);
+        RunScript(recursion_script, use_vm, "loops: recursion, "s + engine);
+    }
+}
+
+// Один вызов глубиной в миллион: хвостовые вызовы переиспользуют кадр,
+// иначе такая глубина переполнила бы стек
+void BenchTailCalls() {
+    const string script = MakeRecursionScript(1'000'000, 1);
+    RunScript(script, false, "tail calls: tree walking"s);
+    RunScript(script, true, "tail calls: vm"s);
+}
+
+// Кадры вызовов берутся из CallStack, поэтому число выделений памяти не растёт
+// с числом вызовов. Виртуальная машина не расходует стек процесса на вложенные вызовы
+// и выдерживает глубину в миллион
+void BenchCalls() {
+    const string script = MakeDeepCallScript(1'000, 1'000);
+    RunScript(script, false, "calls: depth 1000, tree walking"s);
+    RunScript(script, true, "calls: depth 1000, vm"s);
+
+    auto& stack = runtime::CallStack::Get();
+    const size_t max_depth = stack.GetMaxDepth();
+    stack.SetMaxDepth(2'000'000);
+    RunScript(MakeDeepCallScript(1'000'000, 1), true, "calls: depth 1000000, vm"s);
+    stack.SetMaxDepth(max_depth);
+}
+
+void BenchConstantsScript() {
+    const string script = MakeConstantsScript(500, 1000);
+    RunScript(script, false, "constants script: tree walking"s);
+    RunScript(script, true, "constants script: vm"s);
+}
+
+// Копирование ObjectHolder, владеющих объектами в куче: так передаются аргументы,
+// возвращаемые значения и содержимое Closure
+void BenchHolderCopy() {
+    constexpr int OBJECTS = 1'000;
+    constexpr int ROUNDS = 20'000;
+
+    runtime::Class cls{"Empty"s, {}, nullptr};
+    vector<runtime::ObjectHolder> objects;
+    const size_t allocations_before = allocation_count.load();
+    for (int i = 0; i < OBJECTS; ++i) {
+        objects.push_back(runtime::ObjectHolder::Own(runtime::ClassInstance{cls}));
+    }
+    cerr << "  allocations per object: "s
+         << static_cast<double>(allocation_count.load() - allocations_before) / OBJECTS << endl;
+    cerr << "  sizeof(ObjectHolder): "s << sizeof(runtime::ObjectHolder) << endl;
+
+    vector<runtime::ObjectHolder> copies(objects.size());
+    size_t checksum = 0;
+    {
+        LOG_DURATION("holder copy"s);
+        for (int round = 0; round < ROUNDS; ++round) {
+            for (size_t i = 0; i < objects.size(); ++i) {
+                copies[i] = objects[(i + round) % objects.size()];
+            }
+            checksum += copies[round % copies.size()] ? 1 : 0;
+        }
+    }
+    cerr << "  checksum: "s << checksum << endl;
+}
+
+// Большая программа: много классов с методами и арифметическими выражениями
+string MakeLargeScript(int classes, int methods) {
+    ostringstream script;
+    for (int c = 0; c < classes; ++c) {
+        script << "class C"s << c << ":\n"s;
+        for (int m = 0; m < methods; ++m) {
+            script << "  def m"s << m << "(a, b):\n"s
+                   << "    x = a * "s << m << " + b / 3 - (a + b) * 2\n"s
+                   << "    if x > "s << c << " and not a == b or b < 0:\n"s
+                   << "      print 'branch', x, a, b\n"s
+                   << "      return x + self.m"s << m << "(a - 1, b)\n"s
+                   << "    return str(x) + 'end'\n"s;
+        }
+        script << "\n"s;
+    }
+    script << "print 'parsed'\n"s;
+    return script.str();
+}
+
+// Текущий размер резидентной памяти процесса в килобайтах либо 0, если он неизвестен
+size_t GetRssKb() {
+    ifstream status("/proc/self/status"s);
+    string line;
+    while (getline(status, line)) {
+        if (line.rfind("VmRSS:"s, 0) == 0) {
+            return stoul(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+void BenchParse() {
+    const string script = MakeLargeScript(2000, 10);
+    cerr << "  script: "s << script.size() / 1024 << " KiB"s << endl;
+
+    const size_t rss_before = GetRssKb();
+    const size_t allocations_before = allocation_count.load();
+    unique_ptr<ast::Statement> program;
+    {
+        LOG_DURATION("parse"s);
+        istringstream input(script);
+        parse::Lexer lexer(input);
+        program = ParseProgram(lexer);
+    }
+    cerr << "  allocations: "s << allocation_count.load() - allocations_before << endl;
+    cerr << "  rss growth: "s << GetRssKb() - rss_before << " KiB"s << endl;
+    {
+        LOG_DURATION("teardown"s);
+        program.reset();
+    }
+}
+
+// Считывает все токены программы и возвращает их количество
+size_t CountTokens(parse::Lexer& lexer) {
+    size_t count = 1;
+    while (!lexer.NextToken().Is<parse::token_type::Eof>()) {
+        ++count;
+    }
+    return count;
+}
+
+// Лексический разбор большого файла из потока, из памяти и из отображённого файла
+void BenchLex() {
+    const string script = MakeLargeScript(6000, 10);
+    cerr << "  script: "s << script.size() / 1024 << " KiB"s << endl;
+    const string path = "mython_bench_lex.my"s;
+    ofstream(path, ios::binary) << script;
+
+    auto measure = [](const string& label, auto count_tokens) {
+        const size_t allocations_before = allocation_count.load();
+        size_t tokens = 0;
+        {
+            LOG_DURATION(label);
+            tokens = count_tokens();
+        }
+        cerr << "  tokens: "s << tokens << ", allocations: "s
+             << allocation_count.load() - allocations_before << endl;
+    };
+    measure("lex: istream"s, [&script] {
+        istringstream input(script);
+        parse::Lexer lexer(input);
+        return CountTokens(lexer);
+    });
+    measure("lex: string_view"s, [&script] {
+        parse::Lexer lexer(string_view{script});
+        return CountTokens(lexer);
+    });
+    measure("lex: mapped file"s, [&path] {
+        parse::Lexer lexer(parse::SourceBuffer::FromFile(path));
+        return CountTokens(lexer);
+    });
+    remove(path.c_str());
+}
+
+// Запуск большой программы: разбор текста против загрузки дерева из кэша программ
+void BenchProgramCache() {
+    const string script = MakeLargeScript(2000, 10);
+    const string directory = "mython_bench_cache"s;
+    const ast::ProgramCache cache(directory, script);
+
+    {
+        LOG_DURATION("cache: parse"s);
+        parse::Lexer lexer{string_view{script}};
+        auto program = ParseProgram(lexer);
+        cache.Store(*program);
+    }
+    cerr << "  script: "s << script.size() / 1024 << " KiB, cache file: "s
+         << ifstream(cache.GetPath(), ios::binary | ios::ate).tellg() / 1024 << " KiB"s << endl;
+    for (int i = 0; i < 3; ++i) {
+        unique_ptr<ast::Statement> program;
+        {
+            LOG_DURATION("cache: parse"s);
+            parse::Lexer lexer{string_view{script}};
+            program = ParseProgram(lexer);
+        }
+        program.reset();
+        {
+            LOG_DURATION("cache: load"s);
+            program = cache.Load();
+        }
+        program.reset();
+    }
+    remove(cache.GetPath().c_str());
+    remove(directory.c_str());
+}
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Запускает command и возвращает время до первого байта вывода и до завершения
+pair<chrono::microseconds, chrono::microseconds> MeasureProcess(const string& command) {
+    using namespace chrono;
+    const auto start = steady_clock::now();
+    FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        throw runtime_error("Cannot run "s + command);
+    }
+    fgetc(pipe);
+    const auto first_output = steady_clock::now();
+    while (fgetc(pipe) != EOF) {
+    }
+    pclose(pipe);
+    const auto finish = steady_clock::now();
+    return {duration_cast<microseconds>(first_output - start), duration_cast<microseconds>(finish - start)};
+}
+
+// Время от запуска интерпретатора до первой строки вывода тривиальной программы.
+// Для сравнения замеряется запуск echo через ту же оболочку
+void BenchStartup() {
+    const string path = "mython_bench_startup.my"s;
+    ofstream(path) << "print 'hello'\n"s;
+
+    auto measure = [](const string& label, const string& command) {
+        constexpr size_t RUNS = 30;
+        vector<chrono::microseconds> first_output;
+        vector<chrono::microseconds> total;
+        for (size_t i = 0; i < RUNS; ++i) {
+            const auto [first, all] = MeasureProcess(command);
+            first_output.push_back(first);
+            total.push_back(all);
+        }
+        sort(first_output.begin(), first_output.end());
+        sort(total.begin(), total.end());
+        cerr << label << ": first output min "s << first_output.front().count() << " us, median "s
+             << first_output[RUNS / 2].count() << " us; exit median "s << total[RUNS / 2].count()
+             << " us"s << endl;
+    };
+    measure("startup: echo"s, "echo hello"s);
+    measure("startup: mython"s, "\""s + MYTHON_BINARY + "\" "s + path);
+    remove(path.c_str());
+}
+
+// Поиск метода базового класса у потомка в глубокой иерархии
+void BenchMethodLookup() {
+    constexpr int DEPTH = 16;
+    constexpr int ITERATIONS = 5'000'000;
+
+    vector<unique_ptr<runtime::Class>> chain;
+    for (int i = 0; i < DEPTH; ++i) {
+        vector<runtime::Method> methods;
+        methods.push_back({"own_"s + to_string(i), {}, nullptr});
+        if (i == 0) {
+            methods.push_back({"base_method"s, {}, nullptr});
+        }
+        chain.push_back(make_unique<runtime::Class>("C"s + to_string(i), move(methods),
+                                                    chain.empty() ? nullptr : chain.back().get()));
+    }
+
+    const string name = "base_method"s;
+    size_t found = 0;
+    {
+        LOG_DURATION("method lookup, depth "s + to_string(DEPTH));
+        for (int i = 0; i < ITERATIONS; ++i) {
+            found += chain.back()->GetMethod(name) != nullptr;
+        }
+    }
+    cerr << "  found: "s << found << endl;
+}
+
+// Память таблиц методов у множества классов с разными именами методов
+void BenchManyClasses() {
+    constexpr int CLASSES = 3'000;
+    constexpr int METHODS = 10;
+
+    const size_t rss_before = GetRssKb();
+    vector<unique_ptr<runtime::Class>> classes;
+    {
+        LOG_DURATION("many classes: "s + to_string(CLASSES) + " x "s + to_string(METHODS + 1) + " methods"s);
+        for (int i = 0; i < CLASSES; ++i) {
+            vector<runtime::Method> methods;
+            methods.push_back({"__init__"s, {}, nullptr});
+            for (int j = 0; j < METHODS; ++j) {
+                methods.push_back({"m_"s + to_string(i) + "_"s + to_string(j), {}, nullptr});
+            }
+            classes.push_back(make_unique<runtime::Class>("C"s + to_string(i), move(methods), nullptr));
+        }
+    }
+    cerr << "  rss growth: "s << GetRssKb() - rss_before << " KiB"s << endl;
+}
+
+void BenchFieldsScript() {
+    const string script = MakeFieldsScript(500, 2000);
+    RunScript(script, false, "fields script: tree walking"s);
+    RunScript(script, true, "fields script: vm"s);
+}
+
+// Память и время доступа к полям на большом количестве маленьких объектов
+void BenchFields() {
+    constexpr int INSTANCES = 1'000'000;
+    constexpr int PASSES = 20;
+
+    // Сборщик циклов не запускается, чтобы не искажать замер
+    auto& collector = runtime::CycleCollector::Get();
+    const size_t threshold = collector.GetThreshold();
+    collector.SetThreshold(0);
+
+    runtime::Class cls{"Point"s, {}, nullptr};
+    vector<runtime::ObjectHolder> objects;
+    objects.reserve(INSTANCES);
+    const size_t rss_before = GetRssKb();
+    {
+        LOG_DURATION("fields: create "s + to_string(INSTANCES) + " objects"s);
+        for (int i = 0; i < INSTANCES; ++i) {
+            auto object = runtime::ObjectHolder::Own(runtime::ClassInstance{cls});
+            runtime::Closure& fields = object.TryAs<runtime::ClassInstance>()->Fields();
+            fields["x"s] = runtime::ObjectHolder::Own(runtime::Number{i});
+            fields["y"s] = runtime::ObjectHolder::Own(runtime::Number{1});
+            fields["z"s] = runtime::ObjectHolder::None();
+            objects.push_back(move(object));
+        }
+    }
+    cerr << "  bytes per object: "s << (GetRssKb() - rss_before) * 1024 / INSTANCES << endl;
+
+    const runtime::Symbol name{"y"};
+    int64_t sum = 0;
+    {
+        LOG_DURATION("fields: read by name"s);
+        for (int pass = 0; pass < PASSES; ++pass) {
+            for (const auto& object : objects) {
+                const runtime::Closure& fields = object.TryAs<runtime::ClassInstance>()->Fields();
+                sum += *fields.find(name)->second.TryAsValue<runtime::Number>();
+            }
+        }
+    }
+    cerr << "  sum: "s << sum << endl;
+
+    {
+        LOG_DURATION("fields: teardown"s);
+        objects.clear();
+        objects.shrink_to_fit();
+    }
+    collector.SetThreshold(threshold);
+}
+
+struct Benchmark {
+    string_view name;
+    void (*run)();
+};
+
+const Benchmark BENCHMARKS[] = {
+    {"startup"sv, BenchStartup},
+    {"type_dispatch"sv, BenchTypeDispatch},
+    {"arithmetic"sv, BenchArithmeticScript},
+    {"constants"sv, BenchConstantsScript},
+    {"comparison"sv, BenchComparisonScript},
+    {"loops"sv, BenchLoops},
+    {"tail_calls"sv, BenchTailCalls},
+    {"calls"sv, BenchCalls},
+    {"folding"sv, BenchFoldingScript},
+    {"holder_copy"sv, BenchHolderCopy},
+    {"parse"sv, BenchParse},
+    {"lex"sv, BenchLex},
+    {"program_cache"sv, BenchProgramCache},
+    {"method_lookup"sv, BenchMethodLookup},
+    {"many_classes"sv, BenchManyClasses},
+    {"fields"sv, BenchFields},
+    {"fields_script"sv, BenchFieldsScript},
+};
+
+}  // namespace
+
+// Запускает все замеры либо только перечисленные в аргументах командной строки
+int main(int argc, char* argv[]) {
+    vector<string_view> selected(argv + 1, argv + argc);
+    for (const Benchmark& benchmark : BENCHMARKS) {
+        if (!selected.empty() && find(selected.begin(), selected.end(), benchmark.name) == selected.end()) {
+            continue;
+        }
+        cerr << "== "s << benchmark.name << " =="s << endl;
+        benchmark.run();
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "interpreter.h"
+
+#include "lexer.h"
+#include "parse.h"
+#include "program_cache.h"
+#include "runtime.h"
+#include "statement.h"
+#include "vm.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+// Выполняет программу в новом окружении и по запросу выводит статистику сборщика
+template <typename Run>
+void RunInNewEnvironment(ostream& output, const RunOptions& options, Run run) {
+    auto& collector = runtime::CycleCollector::Get();
+    const auto collected_before = collector.GetTotal();
+    runtime::CallStack::Get().SetMaxDepth(options.max_depth != 0 ? options.max_depth
+                                                                  : runtime::CallStack::DEFAULT_MAX_DEPTH);
+
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    run(closure, context);
+
+    if (options.gc_stats) {
+        closure.clear();
+        collector.Collect();
+        const auto total = collector.GetTotal();
+        cerr << "gc: reclaimed "s << total.objects - collected_before.objects << " objects, "s
+             << total.bytes - collected_before.bytes << " bytes"s << endl;
+    }
+}
+
+void ExecuteProgram(runtime::Executable& program, runtime::Closure& closure,
+                    runtime::Context& context, const RunOptions& options) {
+    if (options.use_vm) {
+        vm::RunProgram(program, closure, context);
+    } else {
+        program.Execute(closure, context);
+    }
+}
+
+}  // namespace
+
+void RunMythonProgram(parse::Lexer& lexer, ostream& output, const RunOptions& options) {
+    RunInNewEnvironment(output, options, [&](runtime::Closure& closure, runtime::Context& context) {
+        if (options.stream) {
+            // Одна машина на всю программу, чтобы методы классов компилировались один раз
+            parse::StatementReader reader(lexer);
+            vm::Machine machine;
+            while (auto statement = reader.Next()) {
+                if (options.use_vm) {
+                    machine.Run(*vm::CompileProgram(*statement), closure, context);
+                } else {
+                    statement->Execute(closure, context);
+                }
+            }
+        } else {
+            auto program = ParseProgram(lexer);
+            ExecuteProgram(*program, closure, context, options);
+        }
+    });
+}
+
+void RunCachedMythonProgram(string_view source, ostream& output, const RunOptions& options) {
+    const ast::ProgramCache cache(options.cache_dir, source);
+    auto program = cache.Load();
+    if (!program) {
+        parse::Lexer lexer(source);
+        program = ParseProgram(lexer);
+        try {
+            cache.Store(*program);
+        } catch (const ast::CacheError& e) {
+            // Без кэша программа всё равно выполняется, только следующий запуск снова её разберёт
+            cerr << e.what() << endl;
+        }
+    }
+    RunInNewEnvironment(output, options, [&](runtime::Closure& closure, runtime::Context& context) {
+        ExecuteProgram(*program, closure, context, options);
+    });
+}
+
+void RunMythonProgram(istream& input, ostream& output, const RunOptions& options) {
+    parse::Lexer lexer(input);
+    RunMythonProgram(lexer, output, options);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace parse {
+class Lexer;
+}
+
+// Параметры запуска интерпретатора
+struct RunOptions {
+    // Выполнять программу на виртуальной машине вместо обхода дерева
+    bool use_vm = false;
+    // Вывести в std::cerr статистику сборщика циклических ссылок
+    bool gc_stats = false;
+    // Выполнять каждую инструкцию верхнего уровня сразу после её разбора
+    bool stream = false;
+    // Файл с программой. Если не задан, программа читается из std::cin
+    std::string source_path;
+    // Каталог кэша разобранных программ. Если не задан, программа всегда разбирается заново
+    std::string cache_dir;
+    // Наибольшая глубина вызовов методов. 0 оставляет runtime::CallStack::DEFAULT_MAX_DEPTH.
+    // При обходе дерева глубину дополнительно ограничивает размер стека процесса
+    std::size_t max_depth = 0;
+};
+
+// Разбирает и выполняет программу, выводя результат в output
+void RunMythonProgram(parse::Lexer& lexer, std::ostream& output, const RunOptions& options);
+void RunMythonProgram(std::istream& input, std::ostream& output, const RunOptions& options = {});
+
+// Берёт разобранную программу из кэша в каталоге options.cache_dir,
+// а при промахе разбирает её и сохраняет в кэш
+void RunCachedMythonProgram(std::string_view source, std::ostream& output, const RunOptions& options);
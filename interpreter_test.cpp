@@ -0,0 +1,348 @@
+#include "interpreter.h"
+#include "runtime.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace {
+
+void TestSimplePrints() {
+    istringstream input(R"(
+print 57
+print 10, 24, -8
+print 'hello'
+print "world"
+print True, False
+print
+print None
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "57\n10 24 -8\nhello\nworld\nTrue False\n\nNone\n");
+}
+
+void TestAssignments() {
+    istringstream input(R"(
+x = 57
+print x
+x = 'C++ black belt'
+print x
+y = False
+x = y
+print x
+x = None
+print x, y
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "57\nC++ black belt\nFalse\nNone False\n");
+}
+
+void TestArithmetics() {
+    istringstream input("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "15 120 -13 3 15\n");
+}
+
+void TestVariablesArePointers() {
+    istringstream input(R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+
+class Dummy:
+  def do_add(counter):
+    counter.add()
+
+x = Counter()
+y = x
+
+x.add()
+y.add()
+
+print x.value
+
+d = Dummy()
+d.do_add(x)
+
+print y.value
+)");
+
+    ostringstream output;
+    RunMythonProgram(input, output);
+
+    ASSERT_EQUAL(output.str(), "2\n3\n");
+}
+
+void TestLoops() {
+    const string program = R"(
+class Counter:
+  def count(n):
+    total = 0
+    for i in range(n):
+      if i == 3:
+        continue
+      if i > 6:
+        break
+      total = total + i
+    return total
+
+  def root(limit):
+    k = 0
+    while True:
+      k = k + 1
+      if k * k > limit:
+        return k - 1
+
+c = Counter()
+print c.count(100), c.root(50)
+s = ''
+for i in range(10, 0, -3):
+  s = s + str(i) + ' '
+print s + str(i)
+n = 0
+while n < 3:
+  n = n + 1
+  for j in range(1, 3):
+    if n == 2:
+      break
+    print n, j
+for q in range(0):
+  print 'never'
+for q in range(2):
+  q = 100
+  print q
+)"s;
+    for (bool use_vm : {false, true}) {
+        RunOptions options;
+        options.use_vm = use_vm;
+
+        istringstream input(program);
+        ostringstream output;
+        RunMythonProgram(input, output, options);
+        ASSERT_EQUAL(output.str(), "18 7\n10 7 4 1 1\n1 1\n1 2\n3 1\n3 2\n100\n100\n"s);
+
+        for (const string& broken : {"for i in range('a'):\n  print i\n"s, "for i in range(1, 2, 0):\n  print i\n"s}) {
+            istringstream broken_input(broken);
+            ostringstream broken_output;
+            ASSERT_THROWS(RunMythonProgram(broken_input, broken_output, options), std::runtime_error);
+        }
+    }
+}
+
+// Хвостовая рекурсия не расходует стек: без переиспользования кадра такая глубина
+// переполнила бы стек. Локальные переменные прошлого вызова не видны следующему
+// Локальная переменная метода, которой ещё ничего не присвоено, не читается как None
+void TestUnassignedLocals() {
+    const string prefix = R"(
+class Reader:
+  def before():
+    print y
+    y = 1
+
+  def maybe(flag):
+    if flag:
+      z = 'set'
+    return z
+
+  def loop(n):
+    for i in range(n):
+      w = i
+    return w
+
+  def none():
+    v = None
+    return v
+
+r = Reader()
+print r.none(), r.maybe(True), r.loop(2)
+)"s;
+    for (bool use_vm : {false, true}) {
+        RunOptions options;
+        options.use_vm = use_vm;
+        for (const string& call : {"r.before()\n"s, "r.maybe(False)\n"s, "r.loop(0)\n"s}) {
+            istringstream input(prefix + call);
+            ostringstream output;
+            ASSERT_THROWS(RunMythonProgram(input, output, options), std::runtime_error);
+            ASSERT_EQUAL(output.str(), "None set 1\n"s);
+        }
+    }
+}
+
+void TestTailCalls() {
+    const string program = R"(
+class Walker:
+  def count(n, acc):
+    if n == 0:
+      return acc
+    for i in range(3):
+      if i == 1:
+        return self.count(n - 1, acc + i)
+
+  def walk(n, other):
+    if n == 0:
+      return 'walker'
+    if n == 1:
+      self = other
+    return self.walk(n - 1, other)
+
+  def stale(n):
+    if n > 0:
+      x = n
+      return self.stale(n - 1)
+    return x
+
+class Runner(Walker):
+  def walk(n, other):
+    return 'runner ' + str(n)
+
+w = Walker()
+print w.count(100000, 0), w.walk(3, Runner()), w.walk(0, Runner())
+w.stale(2)
+)"s;
+    for (bool use_vm : {false, true}) {
+        RunOptions options;
+        options.use_vm = use_vm;
+
+        istringstream input(program);
+        ostringstream output;
+        // Хвостовой вызов не переносит локальные переменные в следующую итерацию
+        ASSERT_THROWS(RunMythonProgram(input, output, options), std::runtime_error);
+        ASSERT_EQUAL(output.str(), "100000 runner 0 walker\n"s);
+    }
+}
+
+// Глубокая рекурсия завершается исключением, а не переполнением стека процесса.
+// После исключения стек вызовов пуст, и следующая программа выполняется как обычно
+void TestStackOverflow() {
+    const string program = R"(
+class Counter:
+  def down(n):
+    if n == 0:
+      return 0
+    return 1 + self.down(n - 1)
+
+  def __add__(other):
+    return self.down(other)
+
+c = Counter()
+print c.down(DEPTH)
+print c + DEPTH
+)"s;
+    const auto with_depth = [&program](int depth) {
+        string text = program;
+        for (size_t pos; (pos = text.find("DEPTH"s)) != string::npos;) {
+            text.replace(pos, 5, to_string(depth));
+        }
+        return text;
+    };
+    for (bool use_vm : {false, true}) {
+        RunOptions options;
+        options.use_vm = use_vm;
+        options.max_depth = 100;
+
+        istringstream deep(with_depth(100));
+        ostringstream output;
+        ASSERT_THROWS(RunMythonProgram(deep, output, options), runtime::StackOverflowError);
+        ASSERT_EQUAL(runtime::CallStack::Get().GetDepth(), 0u);
+
+        // Вызов __add__ тоже занимает кадр
+        istringstream shallow(with_depth(98));
+        output.str(""s);
+        RunMythonProgram(shallow, output, options);
+        ASSERT_EQUAL(output.str(), "98\n98\n"s);
+    }
+}
+
+// Предел глубины выше того, что выдерживает стек процесса, не приводит к его переполнению:
+// обход дерева останавливается исключением, а виртуальная машина рекурсии C++ не использует
+void TestRaisedMaxDepth() {
+    const string program = R"(
+class R:
+  def down(n):
+    if n == 0:
+      return 0
+    return 1 + self.down(n - 1)
+
+r = R()
+print r.down(200000)
+)"s;
+    RunOptions options;
+    options.max_depth = 1000000;
+    {
+        istringstream input(program);
+        ostringstream output;
+        ASSERT_THROWS(RunMythonProgram(input, output, options), runtime::StackOverflowError);
+        ASSERT_EQUAL(runtime::CallStack::Get().GetDepth(), 0u);
+    }
+    {
+        options.use_vm = true;
+        istringstream input(program);
+        ostringstream output;
+        RunMythonProgram(input, output, options);
+        ASSERT_EQUAL(output.str(), "200000\n"s);
+    }
+}
+
+// Инструкция выполняется до того, как разобрана следующая,
+// поэтому ошибка в конце программы не отменяет вывод её начала
+void TestStreaming() {
+    const string program = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add():
+    self.value = self.value + 1
+
+x = Counter()
+x.add()
+print x.value
+if x.value > 0:
+  x.add()
+print x.value, 'done'
+label = 'total'
+print label + ':', x.value
+)"s;
+    for (bool use_vm : {false, true}) {
+        RunOptions options;
+        options.use_vm = use_vm;
+        options.stream = true;
+
+        istringstream input(program);
+        ostringstream output;
+        RunMythonProgram(input, output, options);
+        // Строковая константа остаётся в переменной после того, как инструкция удалена
+        ASSERT_EQUAL(output.str(), "1\n2 done\ntotal: 2\n"s);
+
+        istringstream broken_input("print 1\nprint 2\nprint )\n"s);
+        ostringstream broken_output;
+        ASSERT_THROWS(RunMythonProgram(broken_input, broken_output, options), std::runtime_error);
+        ASSERT_EQUAL(broken_output.str(), "1\n2\n"s);
+    }
+}
+
+}  // namespace
+
+void RunInterpreterTests(TestRunner& tr) {
+    RUN_TEST(tr, TestSimplePrints);
+    RUN_TEST(tr, TestAssignments);
+    RUN_TEST(tr, TestArithmetics);
+    RUN_TEST(tr, TestVariablesArePointers);
+    RUN_TEST(tr, TestStreaming);
+    RUN_TEST(tr, TestLoops);
+    RUN_TEST(tr, TestUnassignedLocals);
+    RUN_TEST(tr, TestTailCalls);
+    RUN_TEST(tr, TestStackOverflow);
+    RUN_TEST(tr, TestRaisedMaxDepth);
+}
@@ -1,34 +1,108 @@
 #include "lexer.h"
 
+#include "scan.h"
+
 #include <algorithm>
-#include <charconv>
-#include <unordered_map>
+#include <array>
 #include <cassert>
+#include <charconv>
+#include <cstdint>
 
 #include <iostream>
 using namespace std;
 
 namespace parse {
 
-const std::unordered_map<std::string_view, Token> Lexer::official_words{
-    {"class", token_type::Class{} },
-    {"return", token_type::Return{} },
-    {"if", token_type::If{} },
-    {"else", token_type::Else{} },
-    {"def", token_type::Def{} },
-    {"print", token_type::Print{} },
-    {"and", token_type::And{} },
-    {"or", token_type::Or{} },
-    {"not", token_type::Not{} },
-    {"==", token_type::Eq{} },
-    {"!=", token_type::NotEq{} },
-    {"<=", token_type::LessOrEq{} },
-    {">=", token_type::GreaterOrEq{} },
-    {"None", token_type::None{} },
-    {"True", token_type::True{} },
-    {"False", token_type::False{} }
+namespace {
+
+using namespace std::string_view_literals;
+
+template <typename T>
+Token MakeToken() {
+    return T{};
+}
+
+struct Keyword {
+    std::string_view word;
+    Token (*make)();
+};
+
+// Ключевые слова и операторы из нескольких символов
+constexpr Keyword KEYWORDS[] = {
+    {"class"sv, MakeToken<token_type::Class>},
+    {"return"sv, MakeToken<token_type::Return>},
+    {"if"sv, MakeToken<token_type::If>},
+    {"else"sv, MakeToken<token_type::Else>},
+    {"def"sv, MakeToken<token_type::Def>},
+    {"print"sv, MakeToken<token_type::Print>},
+    {"and"sv, MakeToken<token_type::And>},
+    {"or"sv, MakeToken<token_type::Or>},
+    {"not"sv, MakeToken<token_type::Not>},
+    {"=="sv, MakeToken<token_type::Eq>},
+    {"!="sv, MakeToken<token_type::NotEq>},
+    {"<="sv, MakeToken<token_type::LessOrEq>},
+    {">="sv, MakeToken<token_type::GreaterOrEq>},
+    {"None"sv, MakeToken<token_type::None>},
+    {"True"sv, MakeToken<token_type::True>},
+    {"False"sv, MakeToken<token_type::False>},
+    {"while"sv, MakeToken<token_type::While>},
+    {"for"sv, MakeToken<token_type::For>},
+    {"in"sv, MakeToken<token_type::In>},
+    {"break"sv, MakeToken<token_type::Break>},
+    {"continue"sv, MakeToken<token_type::Continue>},
 };
 
+constexpr size_t KEYWORD_TABLE_SIZE = 64;
+
+// Хеш по длине, первому и последнему символу. Для списка KEYWORDS он совершенный:
+// BuildKeywordTable не компилируется, если два слова попадают в одну ячейку
+constexpr size_t KeywordHash(std::string_view lex) {
+    return (lex.size() + static_cast<unsigned char>(lex.front()) * 7
+            + static_cast<unsigned char>(lex.back())) % KEYWORD_TABLE_SIZE;
+}
+
+constexpr std::array<int8_t, KEYWORD_TABLE_SIZE> BuildKeywordTable() {
+    std::array<int8_t, KEYWORD_TABLE_SIZE> table{};
+    for (auto& slot : table) {
+        slot = -1;
+    }
+    for (size_t i = 0; i < std::size(KEYWORDS); ++i) {
+        auto& slot = table[KeywordHash(KEYWORDS[i].word)];
+        if (slot != -1) {
+            throw std::logic_error("Keyword hash collision");
+        }
+        slot = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+constexpr std::pair<size_t, size_t> GetKeywordSizes() {
+    std::pair<size_t, size_t> sizes{KEYWORDS[0].word.size(), KEYWORDS[0].word.size()};
+    for (const Keyword& keyword : KEYWORDS) {
+        sizes.first = std::min(sizes.first, keyword.word.size());
+        sizes.second = std::max(sizes.second, keyword.word.size());
+    }
+    return sizes;
+}
+
+// Номер ключевого слова в KEYWORDS по значению хеша либо -1
+constexpr auto KEYWORD_TABLE = BuildKeywordTable();
+constexpr auto KEYWORD_SIZES = GetKeywordSizes();
+
+// Возвращает ключевое слово, совпадающее с lex, либо nullptr
+const Keyword* FindKeyword(std::string_view lex) {
+    if (lex.size() < KEYWORD_SIZES.first || lex.size() > KEYWORD_SIZES.second) {
+        return nullptr;
+    }
+    const int8_t index = KEYWORD_TABLE[KeywordHash(lex)];
+    if (index < 0 || KEYWORDS[index].word != lex) {
+        return nullptr;
+    }
+    return &KEYWORDS[index];
+}
+
+}  // namespace
+
 bool operator==(const Token& lhs, const Token& rhs) {
     using namespace token_type;
 
@@ -89,6 +163,11 @@ std::ostream& operator<<(std::ostream& os, const Token& rhs) {
     UNVALUED_OUTPUT(None);
     UNVALUED_OUTPUT(True);
     UNVALUED_OUTPUT(False);
+    UNVALUED_OUTPUT(While);
+    UNVALUED_OUTPUT(For);
+    UNVALUED_OUTPUT(In);
+    UNVALUED_OUTPUT(Break);
+    UNVALUED_OUTPUT(Continue);
     UNVALUED_OUTPUT(Eof);
 
 #undef UNVALUED_OUTPUT
@@ -96,7 +175,19 @@ std::ostream& operator<<(std::ostream& os, const Token& rhs) {
     return os << "Unknown token :("sv;
 }
 
-Lexer::Lexer(std::istream& input) : input_{input} {
+Lexer::Lexer(std::istream& input) : input_{&input} {
+    ReadFirstToken();
+}
+
+Lexer::Lexer(std::string_view text) : text_{text} {
+    ReadFirstToken();
+}
+
+Lexer::Lexer(SourceBuffer source) : source_{std::move(source)}, text_{source_->GetText()} {
+    ReadFirstToken();
+}
+
+void Lexer::ReadFirstToken() {
     do {
         current_token_ = PullNextToken();
     } while(current_token_ == token_type::Newline{});
@@ -111,45 +202,57 @@ const Token& Lexer::CurrentToken() const {
 }
 
     
-Token Lexer::NextToken() {
+const Token& Lexer::NextToken() {
     current_token_ = PullNextToken();
     return current_token_;
 }
     
 std::string Lexer::ConvertStringToUser(std::string_view input) {
-    std::stringstream ss;
+    std::string result;
     input = input.substr(1, input.size() - 2);
-    for(size_t i = 0; i < input.size(); ++i) {
-        if(input[i] == '\\') {
-            switch(input[++i]) {
-                case 't':
-                    ss << static_cast<char>('\t');
-                    continue;
-                case 'n':
-                    ss << static_cast<char>('\n');
-                    continue;
-            }
+    result.reserve(input.size());
+    size_t i = 0;
+    while (i < input.size()) {
+        // Участок без экранирования копируется целиком
+        const size_t escape = scan::FindQuoteOrEscape(input, i, '\\');
+        result.append(input.substr(i, escape - i));
+        if (escape + 1 >= input.size()) {
+            break;
+        }
+        switch (const char c = input[escape + 1]) {
+            case 't':
+                result.push_back('\t');
+                break;
+            case 'n':
+                result.push_back('\n');
+                break;
+            default:
+                result.push_back(c);
         }
-        ss << static_cast<char>(input[i]);
+        i = escape + 2;
     }
-    return ss.str();
+    return result;
 }
 
 Token Lexer::LexToToken(std::string_view lex) {
     using namespace std::string_view_literals;
     using namespace std::string_literals;
 
-    auto it = official_words.find(lex);
-    if (it != official_words.end()) {
-        return it->second;
+    if (const Keyword* keyword = FindKeyword(lex)) {
+        return keyword->make();
     }
 
-    if (isalpha(lex[0]) || lex[0] == UNDERSCORE) {
-        return token_type::Id{ std::string(lex) };
+    if (scan::IsAlpha(lex[0]) || lex[0] == UNDERSCORE) {
+        return token_type::Id{ runtime::Symbol(lex) };
     }
 
-    if (isdigit(lex[0])) {
-        return token_type::Number{ std::stoi(std::string(lex)) };
+    if (scan::IsDigit(lex[0])) {
+        int value = 0;
+        const auto [end, error] = std::from_chars(lex.data(), lex.data() + lex.size(), value);
+        if (error == std::errc::result_out_of_range) {
+            throw std::out_of_range("Number is too large: "s + std::string(lex));
+        }
+        return token_type::Number{ value };
     }
 
     if (lex.size() == 1) {
@@ -164,13 +267,14 @@ Token Lexer::LexToToken(std::string_view lex) {
 }
 
 std::string_view Lexer::GetString(std::string_view line) {
-    char stop_symbol = line[0];
-    size_t size = 1;
-
-    for (; line[size] != stop_symbol; ++size) {
-        if (line[size] == '\\') {
-            ++size;
-        }
+    const char stop_symbol = line[0];
+    size_t size = scan::FindQuoteOrEscape(line, 1, stop_symbol);
+    // Экранированный символ пропускается вместе с обратной косой чертой
+    while (size < line.size() && line[size] == '\\') {
+        size = scan::FindQuoteOrEscape(line, size + 2, stop_symbol);
+    }
+    if (size >= line.size()) {
+        throw LexerError("Unterminated string literal"s);
     }
     return line.substr(0, size + 1);
 }
@@ -192,11 +296,9 @@ std::pair<std::string_view, std::string_view> Lexer::GetNextLex(std::string_view
         return std::pair{ lex, Lexer::TrimLeft(right_line) };
     };
 
-    if (isalnum(line[0]) || line[0] == UNDERSCORE) {
+    if (scan::IsWordChar(line[0])) {
         //протяженное слово
-        size_t len = 1;
-        for (; len < line.size() && (isalnum(line[len]) || line[len] == UNDERSCORE); ++len);
-        return generate_result(len);
+        return generate_result(scan::SkipWord(line, 1));
     }
 
     if (line[0] == '!' || line[0] == '<' || line[0] == '>' || line[0] == '=') {
@@ -214,52 +316,59 @@ std::pair<std::string_view, std::string_view> Lexer::GetNextLex(std::string_view
     return generate_result(1);
 }
 
-std::list<Token> Lexer::SplitLineOnTokens(std::string_view line) {
-    std::list<Token> retval{};
+void Lexer::SplitLineOnTokens(std::string_view line) {
     while (line.size()) {
         auto [lex, right_line] = GetNextLex(line);
         line = right_line;
         if (lex[0] != COMMENT_FRONT) {
-            retval.push_back(LexToToken(lex));
+            current_line_.tokens.push_back(LexToToken(lex));
         }
     }
-    return retval;
 }
 
 std::string_view Lexer::TrimLeft(std::string_view line) {
-    auto beg = line.find_first_not_of(TRIM_SYMBOLS);
-    if (beg == line.npos) {
-        return "";
-    }
-    return line.substr(beg);
+    return line.substr(scan::SkipSpaces(line, 0));
 }
 
-Lexer::Line Lexer::SplitLine(std::string_view line) {
-    Line retval;
+void Lexer::SplitLine(std::string_view line) {
     size_t indent = line.find_first_not_of(SPACE);
     assert(indent % SPACE_ON_INDENT == 0);
-    retval.indent = indent / SPACE_ON_INDENT;
-    line = TrimLeft(line);
-    assert(line.size());
-    retval.tokens = SplitLineOnTokens(line);
-    retval.tokens.push_back(token_type::Newline{});
-    return retval;
+    current_line_.indent = indent / SPACE_ON_INDENT;
+    current_line_.tokens.clear();
+    current_line_.position = 0;
+    SplitLineOnTokens(TrimLeft(line));
+    current_line_.tokens.push_back(token_type::Newline{});
 } 
 
-std::optional<Lexer::Line> Lexer::GetNextLine() {
-    std::string line;
+std::optional<std::string_view> Lexer::GetNextRawLine() {
+    if (input_ != nullptr) {
+        if (!std::getline(*input_, line_buffer_)) {
+            return std::nullopt;
+        }
+        return line_buffer_;
+    }
+    if (text_position_ >= text_.size()) {
+        return std::nullopt;
+    }
+    size_t end = text_.find('\n', text_position_);
+    if (end == std::string_view::npos) {
+        end = text_.size();
+    }
+    const std::string_view line = text_.substr(text_position_, end - text_position_);
+    text_position_ = end + 1;
+    return line;
+}
 
-    while (std::getline(input_, line)) {
-        std::string_view line_view{ line };
-        if (line_view.size()) {//если от длины что то осталось, значит строка не пустая, бинго
-            Line line = SplitLine(line_view);
-            if (line.tokens.size() > 1) {//если там что то помимо Newline
-                return line;
+bool Lexer::ReadNextLine() {
+    while (auto line = GetNextRawLine()) {
+        if (!TrimLeft(*line).empty()) {
+            SplitLine(*line);
+            if (current_line_.tokens.size() > 1) {//если там что то помимо Newline
+                return true;
             }
         }
     }
-
-    return {};
+    return false;
 }
 
 Token Lexer::PullNextToken() {
@@ -274,14 +383,11 @@ Token Lexer::PullNextToken() {
         return token_type::Dedent{};
     }
 
-    if (current_line_.tokens.size()) {
-        Token token = current_line_.tokens.front();
-        current_line_.tokens.pop_front();
-        return token;
+    if (current_line_.position < current_line_.tokens.size()) {
+        return std::move(current_line_.tokens[current_line_.position++]);
     }
 
-    auto line = GetNextLine();
-    if (!line) {
+    if (!ReadNextLine()) {
         if (indent_ == 0) {
             return token_type::Eof{};
         }
@@ -290,8 +396,6 @@ Token Lexer::PullNextToken() {
         return token_type::Dedent{};
     }
 
-    current_line_ = std::move(*line);
-
     assert(current_line_.tokens.size() > 0);
 
     if (current_line_.indent > indent_) {
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "source.h"
+#include "symbol.h"
+
 #include <iosfwd>
 #include <optional>
 #include <sstream>
@@ -7,9 +10,8 @@
 #include <string>
 #include <variant>
 #include <string_view>
-#include <list>
 #include <utility>
-#include <unordered_map>
+#include <vector>
 
 
 namespace parse {
@@ -19,8 +21,8 @@ struct Number {  // Лексема «число»
     int value;   // число
 };
 
-struct Id {             // Лексема «идентификатор»
-    std::string value;  // Имя идентификатора
+struct Id {                 // Лексема «идентификатор»
+    runtime::Symbol value;  // Имя идентификатора
 };
 
 struct Char {    // Лексема «символ»
@@ -51,6 +53,11 @@ struct GreaterOrEq {};  // Лексема «>=»
 struct None {};         // Лексема «None»
 struct True {};         // Лексема «True»
 struct False {};        // Лексема «False»
+struct While {};        // Лексема «while»
+struct For {};          // Лексема «for»
+struct In {};           // Лексема «in»
+struct Break {};        // Лексема «break»
+struct Continue {};     // Лексема «continue»
 }  // namespace token_type
 
 using TokenBase
@@ -59,7 +66,9 @@ using TokenBase
                    token_type::Def, token_type::Newline, token_type::Print, token_type::Indent,
                    token_type::Dedent, token_type::And, token_type::Or, token_type::Not,
                    token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
-                   token_type::None, token_type::True, token_type::False, token_type::Eof>;
+                   token_type::None, token_type::True, token_type::False, token_type::While,
+                   token_type::For, token_type::In, token_type::Break, token_type::Continue,
+                   token_type::Eof>;
 
 struct Token : TokenBase {
     using TokenBase::TokenBase;
@@ -99,13 +108,22 @@ public:
     static constexpr std::string_view TRIM_SYMBOLS{ " \t\r" };
     static constexpr size_t SPACE_ON_INDENT = 2;
 
+    // Читает программу из потока построчно
     explicit Lexer(std::istream& input);
+    // Разбирает текст text без копирования. Текст должен существовать, пока используется лексер
+    explicit Lexer(std::string_view text);
+    // Разбирает текст source, которым лексер владеет
+    explicit Lexer(SourceBuffer source);
+
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
 
     // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
     [[nodiscard]] const Token& CurrentToken() const;
 
-    // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился
-    Token NextToken();
+    // Возвращает следующий токен, либо token_type::Eof, если поток токенов закончился.
+    // Ссылка действительна до следующего вызова NextToken
+    const Token& NextToken();
 
     // Если текущий токен имеет тип T, метод возвращает ссылку на него.
     // В противном случае метод выбрасывает исключение LexerError
@@ -149,27 +167,40 @@ public:
 
 private:
 
+    // Токены очередной непустой строки. Память векторов переиспользуется от строки к строке
     struct Line {
-        size_t indent;
-        std::list<Token> tokens{};
+        size_t indent = 0;
+        std::vector<Token> tokens;
+        // Номер следующего токена
+        size_t position = 0;
     };
 
-    std::istream& input_;
+    // Поток, из которого читается программа, либо nullptr, если разбирается текст text_
+    std::istream* input_ = nullptr;
+    std::optional<SourceBuffer> source_;
+    std::string_view text_;
+    // Позиция начала следующей строки в text_
+    size_t text_position_ = 0;
+    // Последняя прочитанная из потока строка
+    std::string line_buffer_;
+
     size_t indent_ = 0;
     size_t dedent_queue_ = 0;
     size_t indent_queue_ = 0;
     Token current_token_;
     Line current_line_;
 
-    static const std::unordered_map<std::string_view, Token> official_words;
     
     bool IsStringBegin(char c);
+    // Читает первый токен программы, пропуская пустые строки в начале
+    void ReadFirstToken();
     Token PullNextToken();
     std::string ConvertStringToUser(std::string_view input);
 
-    std::optional<Line> GetNextLine();
-    Line SplitLine(std::string_view line);
-    std::list<Token> SplitLineOnTokens(std::string_view line);
+    std::optional<std::string_view> GetNextRawLine();
+    bool ReadNextLine();
+    void SplitLine(std::string_view line);
+    void SplitLineOnTokens(std::string_view line);
     std::pair<std::string_view, std::string_view> GetNextLex(std::string_view line);
     Token LexToToken(std::string_view lex);
     static std::string_view GetString(std::string_view line);
@@ -1,8 +1,12 @@
 #include "lexer.h"
+#include "scan.h"
 #include "test_runner_p.h"
 
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -23,7 +27,7 @@ void TestSimpleAssignment() {
 }
 
 void TestKeywords() {
-    istringstream input("class return if else def print or None and not True False"s);
+    istringstream input("class return if else def print or None and not True False while for in break continue range"s);
     Lexer lexer(input);
 
     ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Class{}));
@@ -38,6 +42,13 @@ void TestKeywords() {
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Not{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::True{}));
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::False{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::While{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::For{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::In{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Break{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Continue{}));
+    // range - обычный идентификатор, его распознаёт синтаксический анализатор
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"range"s}));
 }
 
 void TestNumbers() {
@@ -64,6 +75,122 @@ void TestIds() {
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"dEf"s}));
 }
 
+// Слова, похожие на ключевые, остаются идентификаторами
+void TestKeywordLookalikes() {
+    istringstream input("classes cl iff retur None_ nOt Fals ifs print2 _def an"s);
+    Lexer lexer(input);
+
+    for (const string& id : {"classes"s, "cl"s, "iff"s, "retur"s, "None_"s, "nOt"s, "Fals"s,
+                             "ifs"s, "print2"s, "_def"s, "an"s}) {
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{id}));
+        lexer.NextToken();
+    }
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Newline{}));
+}
+
+void TestIdsAreInterned() {
+    istringstream input("point.x = other.x\n"s);
+    Lexer lexer(input);
+
+    const runtime::Symbol first = lexer.CurrentToken().As<token_type::Id>().value;
+    lexer.NextToken();
+    const runtime::Symbol x = lexer.NextToken().As<token_type::Id>().value;
+    lexer.NextToken();
+    const runtime::Symbol other = lexer.NextToken().As<token_type::Id>().value;
+    lexer.NextToken();
+    const runtime::Symbol other_x = lexer.NextToken().As<token_type::Id>().value;
+
+    // Одинаковые идентификаторы разделяют одну строку
+    ASSERT(x == other_x);
+    ASSERT(&x.Str() == &other_x.Str());
+    ASSERT(first != other);
+    ASSERT_EQUAL(first.Str(), "point"s);
+}
+
+// Векторный поиск совпадает с побайтовым для любых байтов на любых позициях,
+// в том числе на границах 16- и 32-байтных блоков
+void TestScanMatchesScalar() {
+    for (int stop = 0; stop < 256; ++stop) {
+        for (size_t length : {1, 15, 16, 17, 31, 32, 33, 70}) {
+            const string_view alphabet = "ab_Z09 \t\r'\"\\\x80#"sv;
+            string text(length + 8, 'a');
+            for (size_t i = 0; i < text.size(); ++i) {
+                text[i] = alphabet[(i * 7) % alphabet.size()];
+            }
+            text[length - 1] = static_cast<char>(stop);
+            for (size_t pos = 0; pos < length; ++pos) {
+                const string_view word(text.data() + pos, length - pos);
+                string same(length, 'x');
+                same[length - 1] = static_cast<char>(stop);
+                const string spaces = string(length - 1, ' ') + static_cast<char>(stop);
+                const string plain = string(length - 1, 'q') + static_cast<char>(stop);
+
+                ASSERT_EQUAL(scan::SkipWord(same, pos), scan::SkipWordScalar(same, pos));
+                ASSERT_EQUAL(scan::SkipSpaces(spaces, pos), scan::SkipSpacesScalar(spaces, pos));
+                ASSERT_EQUAL(scan::FindQuoteOrEscape(plain, pos, '\''),
+                             scan::FindQuoteOrEscapeScalar(plain, pos, '\''));
+                ASSERT_EQUAL(scan::SkipWord(word, 0), scan::SkipWordScalar(word, 0));
+                ASSERT_EQUAL(scan::SkipSpaces(word, 0), scan::SkipSpacesScalar(word, 0));
+                ASSERT_EQUAL(scan::FindQuoteOrEscape(word, 0, '"'),
+                             scan::FindQuoteOrEscapeScalar(word, 0, '"'));
+            }
+        }
+    }
+}
+
+vector<Token> ReadAllTokens(Lexer& lexer) {
+    vector<Token> tokens{lexer.CurrentToken()};
+    while (!tokens.back().Is<token_type::Eof>()) {
+        tokens.push_back(lexer.NextToken());
+    }
+    return tokens;
+}
+
+// Разбор потока, строки в памяти и отображённого в память файла даёт одинаковые токены
+void TestSourceBuffers() {
+    const string program = R"(
+
+# comment
+class Counter:
+  def __init__():
+    self.value = 'tab\tand\nnewline' # trailing comment
+  def add(n):
+    if n >= 10:
+      return 'x' + "y"
+print 1, 23, Counter()
+x = 5)"s;
+
+    istringstream input(program);
+    Lexer stream_lexer(input);
+    const vector<Token> expected = ReadAllTokens(stream_lexer);
+    ASSERT(expected.size() > 40U);
+
+    Lexer view_lexer{string_view{program}};
+    ASSERT_EQUAL(ReadAllTokens(view_lexer), expected);
+
+    Lexer string_lexer{SourceBuffer::FromString(program)};
+    ASSERT_EQUAL(ReadAllTokens(string_lexer), expected);
+
+    const auto path = filesystem::temp_directory_path() / "mython_lexer_test.my";
+    ofstream(path, ios::binary) << program;
+    {
+        SourceBuffer source = SourceBuffer::FromFile(path.string());
+#if !defined(_WIN32)
+        ASSERT(source.IsMapped());
+#endif
+        ASSERT_EQUAL(source.GetText(), program);
+        Lexer file_lexer{std::move(source)};
+        ASSERT_EQUAL(ReadAllTokens(file_lexer), expected);
+    }
+    ofstream(path, ios::binary | ios::trunc).flush();
+    {
+        Lexer empty_lexer{SourceBuffer::FromFile(path.string())};
+        ASSERT_EQUAL(empty_lexer.CurrentToken(), Token(token_type::Eof{}));
+    }
+    filesystem::remove(path);
+    ASSERT_THROWS(SourceBuffer::FromFile(path.string()), std::runtime_error);
+}
+
 void TestStrings() {
     istringstream input(
         R"('word' "two words" 'long string with a double quote " inside' "another long string with single quote ' inside")"s);
@@ -358,6 +485,8 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestKeywords);
     RUN_TEST(tr, parse::TestNumbers);
     RUN_TEST(tr, parse::TestIds);
+    RUN_TEST(tr, parse::TestKeywordLookalikes);
+    RUN_TEST(tr, parse::TestIdsAreInterned);
     RUN_TEST(tr, parse::TestStrings);
     RUN_TEST(tr, parse::TestOperations);
     RUN_TEST(tr, parse::TestIndentsAndNewlines);
@@ -367,6 +496,8 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestSourceBuffers);
+    RUN_TEST(tr, parse::TestScanMatchesScalar);
 }
 
 }  // namespace parse
\ No newline at end of file
@@ -1,137 +1,72 @@
+#include "interpreter.h"
 #include "lexer.h"
-#include "parse.h"
-#include "runtime.h"
-#include "statement.h"
-#include "test_runner_p.h"
 
+#include <charconv>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
 
 using namespace std;
 
-namespace parse {
-void RunOpenLexerTests(TestRunner& tr);
-}  // namespace parse
-
-namespace ast {
-void RunUnitTests(TestRunner& tr);
-}
-namespace runtime {
-void RunObjectHolderTests(TestRunner& tr);
-void RunObjectsTests(TestRunner& tr);
-}  // namespace runtime
-
-void TestParseProgram(TestRunner& tr);
-
 namespace {
 
-void RunMythonProgram(istream& input, ostream& output) {
-    parse::Lexer lexer(input);
-    auto program = ParseProgram(lexer);
-
-    runtime::SimpleContext context{output};
-    runtime::Closure closure;
-    program->Execute(closure, context);
-}
-
-void TestSimplePrints() {
-    istringstream input(R"(
-print 57
-print 10, 24, -8
-print 'hello'
-print "world"
-print True, False
-print
-print None
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "57\n10 24 -8\nhello\nworld\nTrue False\n\nNone\n");
-}
-
-void TestAssignments() {
-    istringstream input(R"(
-x = 57
-print x
-x = 'C++ black belt'
-print x
-y = False
-x = y
-print x
-x = None
-print x, y
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "57\nC++ black belt\nFalse\nNone False\n");
-}
-
-void TestArithmetics() {
-    istringstream input("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
+constexpr string_view CACHE_DIR_OPTION = "--cache-dir="sv;
+constexpr string_view MAX_DEPTH_OPTION = "--max-depth="sv;
 
-    ASSERT_EQUAL(output.str(), "15 120 -13 3 15\n");
-}
-
-void TestVariablesArePointers() {
-    istringstream input(R"(
-class Counter:
-  def __init__():
-    self.value = 0
-
-  def add():
-    self.value = self.value + 1
-
-class Dummy:
-  def do_add(counter):
-    counter.add()
-
-x = Counter()
-y = x
-
-x.add()
-y.add()
-
-print x.value
-
-d = Dummy()
-d.do_add(x)
-
-print y.value
-)");
-
-    ostringstream output;
-    RunMythonProgram(input, output);
-
-    ASSERT_EQUAL(output.str(), "2\n3\n");
+size_t ParseMaxDepth(string_view value) {
+    size_t depth = 0;
+    const auto [end, error] = from_chars(value.data(), value.data() + value.size(), depth);
+    if (error != errc{} || end != value.data() + value.size() || depth == 0) {
+        throw std::invalid_argument("Invalid max depth: "s + string(value));
+    }
+    return depth;
 }
 
-void TestAll() {
-    TestRunner tr;
-    parse::RunOpenLexerTests(tr);
-    runtime::RunObjectHolderTests(tr);
-    runtime::RunObjectsTests(tr);
-    ast::RunUnitTests(tr);
-    TestParseProgram(tr);
-
-    RUN_TEST(tr, TestSimplePrints);
-    RUN_TEST(tr, TestAssignments);
-    RUN_TEST(tr, TestArithmetics);
-    RUN_TEST(tr, TestVariablesArePointers);
+RunOptions ParseOptions(int argc, char* argv[]) {
+    RunOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string_view arg = argv[i];
+        if (arg == "--vm"sv) {
+            options.use_vm = true;
+        } else if (arg == "--gc-stats"sv) {
+            options.gc_stats = true;
+        } else if (arg == "--stream"sv) {
+            options.stream = true;
+        } else if (arg.substr(0, CACHE_DIR_OPTION.size()) == CACHE_DIR_OPTION) {
+            options.cache_dir = arg.substr(CACHE_DIR_OPTION.size());
+        } else if (arg.substr(0, MAX_DEPTH_OPTION.size()) == MAX_DEPTH_OPTION) {
+            options.max_depth = ParseMaxDepth(arg.substr(MAX_DEPTH_OPTION.size()));
+        } else if (arg.substr(0, 2) != "--"sv && options.source_path.empty()) {
+            options.source_path = arg;
+        } else {
+            throw std::invalid_argument("Unknown option: "s + string(arg));
+        }
+    }
+    if (options.stream && !options.cache_dir.empty()) {
+        throw std::invalid_argument("--stream cannot be combined with --cache-dir"s);
+    }
+    return options;
 }
 
 }  // namespace
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
-        TestAll();
-
-        RunMythonProgram(cin, cout);
+        const RunOptions options = ParseOptions(argc, argv);
+
+        if (!options.cache_dir.empty()) {
+            // Ключ кэша - хэш всего текста, поэтому программа читается целиком
+            const auto source = options.source_path.empty()
+                                    ? parse::SourceBuffer::FromString({istreambuf_iterator<char>(cin), {}})
+                                    : parse::SourceBuffer::FromFile(options.source_path);
+            RunCachedMythonProgram(source.GetText(), cout, options);
+        } else if (options.source_path.empty()) {
+            RunMythonProgram(cin, cout, options);
+        } else {
+            parse::Lexer lexer(parse::SourceBuffer::FromFile(options.source_path));
+            RunMythonProgram(lexer, cout, options);
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
 		return 1;
@@ -0,0 +1,205 @@
+#include "optimizer.h"
+
+#include "statement.h"
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+bool IsConstant(const Statement& statement) {
+    return dynamic_cast<const NumericConst*>(&statement) != nullptr
+           || dynamic_cast<const StringConst*>(&statement) != nullptr
+           || dynamic_cast<const BoolConst*>(&statement) != nullptr
+           || dynamic_cast<const None*>(&statement) != nullptr;
+}
+
+// Возвращает true, если внутри statement объявлен класс. Такую инструкцию нельзя удалить,
+// даже если она не выполнится: после разбора узел ClassDefinition - единственный владелец
+// класса, на который ссылаются узлы NewInstance
+bool DeclaresClass(Statement& statement) {
+    if (dynamic_cast<const ClassDefinition*>(&statement) != nullptr) {
+        return true;
+    }
+    if (auto* compound = dynamic_cast<Compound*>(&statement)) {
+        for (const auto& nested : compound->GetStatements()) {
+            if (DeclaresClass(*nested)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (auto* if_else = dynamic_cast<IfElse*>(&statement)) {
+        return DeclaresClass(*if_else->GetIfBody())
+               || (if_else->GetElseBody() && DeclaresClass(*if_else->GetElseBody()));
+    }
+    if (auto* loop = dynamic_cast<While*>(&statement)) {
+        return DeclaresClass(*loop->GetBody());
+    }
+    if (auto* loop = dynamic_cast<ForRange*>(&statement)) {
+        return DeclaresClass(*loop->GetBody());
+    }
+    return false;
+}
+
+bool IsMinusOne(const Statement& statement) {
+    const auto* num = dynamic_cast<const NumericConst*>(&statement);
+    return num != nullptr && num->GetValue().GetValue() == -1;
+}
+
+class ConstantFolder {
+public:
+    void Fold(unique_ptr<Statement>& statement) {
+        if (auto* compound = dynamic_cast<Compound*>(statement.get())) {
+            FoldCompound(*compound);
+        } else if (auto* if_else = dynamic_cast<IfElse*>(statement.get())) {
+            FoldIfElse(statement, *if_else);
+        } else if (auto* loop = dynamic_cast<While*>(statement.get())) {
+            FoldWhile(statement, *loop);
+        } else if (auto* loop = dynamic_cast<ForRange*>(statement.get())) {
+            Fold(loop->GetStart());
+            Fold(loop->GetStop());
+            Fold(loop->GetStep());
+            Fold(loop->GetBody());
+        } else if (auto* ret = dynamic_cast<Return*>(statement.get())) {
+            Fold(ret->GetStatement());
+        } else if (auto* assignment = dynamic_cast<Assignment*>(statement.get())) {
+            Fold(assignment->GetValue());
+        } else if (auto* field = dynamic_cast<FieldAssignment*>(statement.get())) {
+            Fold(field->GetValue());
+        } else if (auto* print = dynamic_cast<Print*>(statement.get())) {
+            FoldAll(print->GetArgs());
+        } else if (auto* call = dynamic_cast<MethodCall*>(statement.get())) {
+            Fold(call->GetObject());
+            FoldAll(call->GetArgs());
+        } else if (auto* instance = dynamic_cast<NewInstance*>(statement.get())) {
+            FoldAll(instance->GetArgs());
+        } else if (auto* unary = dynamic_cast<UnaryOperation*>(statement.get())) {
+            Fold(unary->GetArgument());
+            if (IsConstant(*unary->GetArgument())) {
+                TryEvaluate(statement);
+            }
+        } else if (auto* op_or = dynamic_cast<Or*>(statement.get())) {
+            FoldShortCircuit(statement, *op_or);
+        } else if (auto* op_and = dynamic_cast<And*>(statement.get())) {
+            FoldShortCircuit(statement, *op_and);
+        } else if (auto* binary = dynamic_cast<BinaryOperation*>(statement.get())) {
+            Fold(binary->GetLhs());
+            Fold(binary->GetRhs());
+            if (IsConstant(*binary->GetLhs()) && IsConstant(*binary->GetRhs())) {
+                TryEvaluate(statement);
+            } else if (dynamic_cast<Mult*>(binary) != nullptr && IsMinusOne(*binary->GetRhs())) {
+                // Так парсер записывает унарный минус
+                statement = make_unique<Negate>(move(binary->GetLhs()));
+            }
+        }
+    }
+
+private:
+    // Ветки if с константным условием вставляются в объемлющую составную инструкцию,
+    // чтобы не заводить лишний уровень вложенности
+    void FoldCompound(Compound& compound) {
+        auto& statements = compound.GetStatements();
+        vector<unique_ptr<Statement>> result;
+        result.reserve(statements.size());
+        for (auto& statement : statements) {
+            Fold(statement);
+            if (auto* nested = dynamic_cast<Compound*>(statement.get())) {
+                for (auto& nested_statement : nested->GetStatements()) {
+                    result.push_back(move(nested_statement));
+                }
+            } else {
+                result.push_back(move(statement));
+            }
+        }
+        statements = move(result);
+    }
+
+    void FoldIfElse(unique_ptr<Statement>& statement, IfElse& if_else) {
+        Fold(if_else.GetCondition());
+        Fold(if_else.GetIfBody());
+        if (if_else.GetElseBody()) {
+            Fold(if_else.GetElseBody());
+        }
+        if (!IsConstant(*if_else.GetCondition())) {
+            return;
+        }
+
+        const bool condition = runtime::IsTrue(if_else.GetCondition()->Execute(closure_, context_));
+        const unique_ptr<Statement>& dead = condition ? if_else.GetElseBody() : if_else.GetIfBody();
+        if (dead && DeclaresClass(*dead)) {
+            return;
+        }
+        unique_ptr<Statement> branch = condition ? move(if_else.GetIfBody()) : move(if_else.GetElseBody());
+        statement = branch ? move(branch) : make_unique<Compound>();
+    }
+
+    // Цикл с ложным константным условием не выполняется ни разу
+    void FoldWhile(unique_ptr<Statement>& statement, While& loop) {
+        Fold(loop.GetCondition());
+        Fold(loop.GetBody());
+        if (IsConstant(*loop.GetCondition()) && !DeclaresClass(*loop.GetBody())
+            && !runtime::IsTrue(loop.GetCondition()->Execute(closure_, context_))) {
+            statement = make_unique<Compound>();
+        }
+    }
+
+    template <bool short_val>
+    void FoldShortCircuit(unique_ptr<Statement>& statement, ShortCircuitBoolOperation<short_val>& operation) {
+        Fold(operation.GetLhs());
+        Fold(operation.GetRhs());
+        const auto* lhs = dynamic_cast<const BoolConst*>(operation.GetLhs().get());
+        if (lhs != nullptr && lhs->GetValue().GetValue() == short_val) {
+            // Правый операнд не вычисляется, каким бы он ни был
+            statement = make_unique<BoolConst>(runtime::Bool{short_val});
+        } else if (IsConstant(*operation.GetLhs()) && IsConstant(*operation.GetRhs())) {
+            TryEvaluate(statement);
+        }
+    }
+
+    void FoldAll(vector<unique_ptr<Statement>>& statements) {
+        for (auto& statement : statements) {
+            Fold(statement);
+        }
+    }
+
+    // Вычисляет узел с константными операндами и заменяет его результатом.
+    // Если вычисление завершилось ошибкой, узел остаётся, и ошибка возникнет при выполнении
+    void TryEvaluate(unique_ptr<Statement>& statement) {
+        runtime::ObjectHolder value;
+        try {
+            value = statement->Execute(closure_, context_);
+        } catch (const std::runtime_error&) {
+            return;
+        }
+
+        if (!value) {
+            statement = make_unique<None>();
+        } else if (const auto* num = value.TryAs<runtime::Number>()) {
+            statement = make_unique<NumericConst>(runtime::Number{num->GetValue()});
+        } else if (const auto* str = value.TryAs<runtime::String>()) {
+            statement = make_unique<StringConst>(runtime::String{str->GetValue()});
+        } else if (const auto* b = value.TryAs<runtime::Bool>()) {
+            statement = make_unique<BoolConst>(runtime::Bool{b->GetValue()});
+        }
+    }
+
+    // Константные выражения не обращаются к переменным и не выводят текст
+    runtime::Closure closure_;
+    runtime::DummyContext context_;
+};
+
+}  // namespace
+
+void FoldConstants(unique_ptr<Statement>& statement) {
+    ConstantFolder().Fold(statement);
+}
+
+void FoldConstants(runtime::Method& method) {
+    if (auto* body = dynamic_cast<MethodBody*>(method.body.get())) {
+        FoldConstants(body->GetBody());
+    }
+}
+
+}  // namespace ast
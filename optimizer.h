@@ -0,0 +1,25 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <memory>
+
+namespace ast {
+
+class Statement;
+
+/*
+ * Сворачивает константные подвыражения арифметики, сравнений, not, and, or и str
+ * в одну константу, заменяет x * -1 узлом Negate, убирает ветки if с константным условием
+ * и циклы while с ложным константным условием. Ветки и циклы, в которых объявлен класс,
+ * не удаляются: класс нужен экземплярам, созданным вне них.
+ * Подвыражение, вычисление которого завершается ошибкой (например, деление на ноль),
+ * остаётся как есть, чтобы ошибка возникла при выполнении программы.
+ * Новые узлы создаются в текущей арене, поэтому функцию вызывают внутри ArenaScope дерева
+ */
+void FoldConstants(std::unique_ptr<Statement>& statement);
+
+// Сворачивает константы в теле метода. Вызывается до ResolveSlots
+void FoldConstants(runtime::Method& method);
+
+}  // namespace ast
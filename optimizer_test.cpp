@@ -0,0 +1,168 @@
+#include "lexer.h"
+#include "optimizer.h"
+#include "parse.h"
+#include "program_cache.h"
+#include "statement.h"
+#include "test_runner_p.h"
+#include "vm.h"
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+unique_ptr<Statement> Parse(const string& program) {
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    return ParseProgram(lexer);
+}
+
+const vector<unique_ptr<Statement>>& GetStatements(const Statement& program) {
+    const auto& root = dynamic_cast<const Program&>(program);
+    return dynamic_cast<const Compound&>(root.GetBody()).GetStatements();
+}
+
+// Выполняет программу обходом дерева и на виртуальной машине и проверяет, что вывод совпадает
+string Run(Statement& program) {
+    runtime::DummyContext context;
+    {
+        runtime::Closure closure;
+        program.Execute(closure, context);
+    }
+    runtime::DummyContext vm_context;
+    {
+        runtime::Closure closure;
+        vm::RunProgram(program, closure, vm_context);
+    }
+    ASSERT_EQUAL(vm_context.output.str(), context.output.str());
+    return context.output.str();
+}
+
+void TestConstantsAreFolded() {
+    auto program = Parse(R"(
+print 2*5+10/2, 'a' + 'b', 1 < 2, not True, str(1 + 2) + '!', -5, None == None
+print True or x, False and x, 3 >= 3 and 'a' != 'b'
+)"s);
+    for (const auto& statement : GetStatements(*program)) {
+        const auto& print = dynamic_cast<const Print&>(*statement);
+        for (const auto& arg : print.GetArgs()) {
+            ASSERT(dynamic_cast<const VariableValue*>(arg.get()) == nullptr);
+            ASSERT(dynamic_cast<const BinaryOperation*>(arg.get()) == nullptr);
+            ASSERT(dynamic_cast<const UnaryOperation*>(arg.get()) == nullptr);
+        }
+    }
+    ASSERT_EQUAL(Run(*program), "15 ab True False 3! -5 True\nTrue False True\n"s);
+}
+
+void TestErrorsAreReportedAtExecution() {
+    auto division = Parse("print 'start'\nx = 1 / 0\n"s);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ASSERT_THROWS(division->Execute(closure, context), std::runtime_error);
+    ASSERT_EQUAL(context.output.str(), "start\n"s);
+
+    for (const string& program : {"print 1 + 'a'\n"s, "print not 1\n"s, "print False or 2\n"s, "print -'a'\n"s}) {
+        auto tree = Parse(program);
+        runtime::Closure program_closure;
+        ASSERT_THROWS(tree->Execute(program_closure, context), std::runtime_error);
+    }
+}
+
+void TestNegate() {
+    auto program = Parse(R"(
+class Vec:
+  def __init__(x):
+    self.x = x
+
+  def __mul__(k):
+    self.x = self.x * k
+    return self
+
+x = 7
+w = Vec(2)
+v = -w
+print -x, x * -1, v.x, -(x - 10)
+)"s);
+    const auto& print = dynamic_cast<const Print&>(*GetStatements(*program).back());
+    ASSERT(dynamic_cast<const Negate*>(print.GetArgs()[0].get()) != nullptr);
+    ASSERT(dynamic_cast<const Negate*>(print.GetArgs()[1].get()) != nullptr);
+    ASSERT_EQUAL(Run(*program), "-7 -7 -2 3\n"s);
+}
+
+void TestDeadBranchesAreDropped() {
+    auto program = Parse(R"(
+class Choice:
+  def pick(n):
+    if 1 > 2:
+      return 'never'
+    if not False:
+      if n > 0:
+        return 'positive'
+      return 'other'
+    return 'unreachable'
+
+c = Choice()
+if 'a' == 'a':
+  print c.pick(1), c.pick(0)
+else:
+  print 'else'
+if False:
+  print 'dropped'
+)"s);
+    const auto& statements = GetStatements(*program);
+    ASSERT_EQUAL(statements.size(), 3U);
+    ASSERT(dynamic_cast<const Print*>(statements.back().get()) != nullptr);
+    ASSERT_EQUAL(Run(*program), "positive other\n"s);
+}
+
+// Класс из мёртвой ветки всё равно доступен: NewInstance ссылается на него с момента разбора
+void TestDeadBranchesKeepClasses() {
+    auto program = Parse(R"(
+if False:
+  class X:
+    def get():
+      return 5
+while False:
+  class Y:
+    def get():
+      return 6
+x = X()
+y = Y()
+print x.get(), y.get()
+)"s);
+    ASSERT_EQUAL(GetStatements(*program).size(), 5U);
+    ASSERT_EQUAL(Run(*program), "5 6\n"s);
+    ASSERT_EQUAL(Run(*DeserializeProgram(SerializeProgram(*program))), "5 6\n"s);
+}
+
+void TestDeadLoopsAreDropped() {
+    auto program = Parse(R"(
+while 1 > 2:
+  print 'never'
+n = 0
+while not n == 3 - 1:
+  n = n + 1
+for i in range(2 * 2):
+  print i, 10 * 10
+print n
+)"s);
+    const auto& statements = GetStatements(*program);
+    ASSERT_EQUAL(statements.size(), 4U);
+    const auto& loop = dynamic_cast<const ForRange&>(*statements[2]);
+    ASSERT(dynamic_cast<const NumericConst*>(&loop.GetStop()) != nullptr);
+    ASSERT_EQUAL(Run(*program), "0 100\n1 100\n2 100\n3 100\n2\n"s);
+}
+
+}  // namespace
+
+void RunOptimizerTests(TestRunner& tr) {
+    RUN_TEST(tr, ast::TestConstantsAreFolded);
+    RUN_TEST(tr, ast::TestErrorsAreReportedAtExecution);
+    RUN_TEST(tr, ast::TestNegate);
+    RUN_TEST(tr, ast::TestDeadBranchesAreDropped);
+    RUN_TEST(tr, ast::TestDeadLoopsAreDropped);
+    RUN_TEST(tr, ast::TestDeadBranchesKeepClasses);
+}
+
+}  // namespace ast
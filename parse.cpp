@@ -1,8 +1,12 @@
 #include "parse.h"
 
 #include "lexer.h"
+#include "optimizer.h"
+#include "resolver.h"
 #include "statement.h"
 
+#include <utility>
+
 using namespace std;
 
 namespace TokenType = parse::token_type;
@@ -34,6 +38,30 @@ public:
         return result;
     }
 
+    // Разбирает очередную инструкцию верхнего уровня и возвращает nullptr в конце программы.
+    // Перевод строки после простой инструкции запоминается, а не пропускается, чтобы
+    // лексер не читал следующую строку, пока инструкция не выполнена
+    unique_ptr<ast::Statement> ParseNextStatement() {
+        if (pending_newline_) {
+            pending_newline_ = false;
+            lexer_.NextToken();
+        }
+
+        const auto& tok = lexer_.CurrentToken();
+        if (tok.Is<TokenType::Eof>()) {
+            return nullptr;
+        }
+        if (tok.Is<TokenType::Class>() || tok.Is<TokenType::If>() || tok.Is<TokenType::While>()
+            || tok.Is<TokenType::For>()) {
+            return ParseStatement();
+        }
+
+        auto result = ParseSimpleStatement();
+        lexer_.Expect<TokenType::Newline>();
+        pending_newline_ = true;
+        return result;
+    }
+
 private:
     // Suite -> NEWLINE INDENT (Statement)+ DEDENT
     unique_ptr<ast::Statement> ParseSuite()  // NOLINT
@@ -76,7 +104,12 @@ private:
             lexer_.ExpectNext<TokenType::Char>(':');
             lexer_.NextToken();
 
+            // break и continue в теле метода не относятся к циклу, внутри которого объявлен класс
+            const int outer_loop_depth = std::exchange(loop_depth_, 0);
             m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            loop_depth_ = outer_loop_depth;
+            ast::FoldConstants(m);
+            ast::ResolveSlots(m);
 
             result.push_back(std::move(m));
         }
@@ -98,7 +131,7 @@ private:
 
             auto it = declared_classes_.find(name);
             if (it == declared_classes_.end()) {
-                throw ParseError("Base class "s + name + " not found for class "s + class_name);
+                throw ParseError("Base class "s + name.Str() + " not found for class "s + class_name);
             }
             base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
         }
@@ -124,8 +157,8 @@ private:
         return make_unique<ast::ClassDefinition>(it->second);
     }
 
-    vector<string> ParseDottedIds() {
-        vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
+    vector<runtime::Symbol> ParseDottedIds() {
+        vector<runtime::Symbol> result(1, lexer_.Expect<TokenType::Id>().value);
 
         while (lexer_.NextToken() == '.') {
             result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
@@ -139,8 +172,8 @@ private:
     unique_ptr<ast::Statement> ParseAssignmentOrCall() {
         lexer_.Expect<TokenType::Id>();
 
-        vector<string> id_list = ParseDottedIds();
-        string last_name = id_list.back();
+        vector<runtime::Symbol> id_list = ParseDottedIds();
+        runtime::Symbol last_name = id_list.back();
         id_list.pop_back();
 
         if (lexer_.CurrentToken() == '=') {
@@ -156,7 +189,7 @@ private:
         lexer_.NextToken();
 
         if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+            throw ParseError("Mython doesn't support functions, only methods: "s + last_name.Str());
         }
 
         vector<unique_ptr<ast::Statement>> args;
@@ -253,7 +286,7 @@ private:
     }
 
     std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
-        vector<string> names = ParseDottedIds();
+        vector<runtime::Symbol> names = ParseDottedIds();
 
         if (lexer_.CurrentToken() == '(') {
             // various calls
@@ -282,7 +315,7 @@ private:
                 }
                 return make_unique<ast::Stringify>(std::move(args.front()));
             }
-            throw ParseError("Unknown call to "s + method_name + "()"s);
+            throw ParseError("Unknown call to "s + method_name.Str() + "()"s);
         }
         return make_unique<ast::VariableValue>(std::move(names));
     }
@@ -323,6 +356,60 @@ private:
                                         std::move(else_body));
     }
 
+    // Loop -> while LogicalExpr: Suite
+    unique_ptr<ast::Statement> ParseWhile()  // NOLINT
+    {
+        lexer_.Expect<TokenType::While>();
+        lexer_.NextToken();
+
+        auto condition = ParseTest();
+
+        lexer_.Expect<TokenType::Char>(':');
+        lexer_.NextToken();
+
+        return make_unique<ast::While>(std::move(condition), ParseLoopBody());
+    }
+
+    // Loop -> for Id in range '(' Expr [, Expr [, Expr]] ')': Suite
+    unique_ptr<ast::Statement> ParseFor()  // NOLINT
+    {
+        lexer_.Expect<TokenType::For>();
+        runtime::Symbol var = lexer_.ExpectNext<TokenType::Id>().value;
+        lexer_.ExpectNext<TokenType::In>();
+        lexer_.ExpectNext<TokenType::Id>("range"sv);
+        lexer_.ExpectNext<TokenType::Char>('(');
+        lexer_.NextToken();
+
+        vector<unique_ptr<ast::Statement>> args;
+        if (lexer_.CurrentToken() != ')') {
+            args = ParseTestList();
+        }
+        lexer_.Expect<TokenType::Char>(')');
+        lexer_.ExpectNext<TokenType::Char>(':');
+        lexer_.NextToken();
+
+        // range(stop) и range(start, stop) считаются с шагом 1, range(stop) - от нуля
+        if (args.empty() || args.size() > 3) {
+            throw ParseError("range() takes from 1 to 3 arguments"s);
+        }
+        if (args.size() == 1) {
+            args.insert(args.begin(), make_unique<ast::NumericConst>(0));
+        }
+        if (args.size() == 2) {
+            args.push_back(make_unique<ast::NumericConst>(1));
+        }
+
+        return make_unique<ast::ForRange>(var, std::move(args[0]), std::move(args[1]),
+                                          std::move(args[2]), ParseLoopBody());
+    }
+
+    unique_ptr<ast::Statement> ParseLoopBody() {
+        ++loop_depth_;
+        auto body = ParseSuite();
+        --loop_depth_;
+        return body;
+    }
+
     // LogicalExpr -> AndTest [OR AndTest]
     // AndTest -> NotTest [AND NotTest]
     // NotTest -> [NOT] NotTest
@@ -361,37 +448,37 @@ private:
     {
         auto result = ParseExpression();
 
-        const auto tok = lexer_.CurrentToken();
+        const parse::Token& tok = lexer_.CurrentToken();
 
         if (tok == '<') {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Less, std::move(result),
-                                                ParseExpression());
+            return ast::MakeComparison(ast::Comparator::Less, std::move(result),
+                                       ParseExpression());
         }
         if (tok == '>') {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
-                                                ParseExpression());
+            return ast::MakeComparison(ast::Comparator::Greater, std::move(result),
+                                       ParseExpression());
         }
         if (tok.Is<TokenType::Eq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
-                                                ParseExpression());
+            return ast::MakeComparison(ast::Comparator::Equal, std::move(result),
+                                       ParseExpression());
         }
         if (tok.Is<TokenType::NotEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
-                                                ParseExpression());
+            return ast::MakeComparison(ast::Comparator::NotEqual, std::move(result),
+                                       ParseExpression());
         }
         if (tok.Is<TokenType::LessOrEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
-                                                ParseExpression());
+            return ast::MakeComparison(ast::Comparator::LessOrEqual, std::move(result),
+                                       ParseExpression());
         }
         if (tok.Is<TokenType::GreaterOrEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
-                                                ParseExpression());
+            return ast::MakeComparison(ast::Comparator::GreaterOrEqual, std::move(result),
+                                       ParseExpression());
         }
         return result;
     }
@@ -399,6 +486,8 @@ private:
     // Statement -> SimpleStatement Newline
     //           | class ClassDefinition
     //           | if Condition
+    //           | while Loop
+    //           | for Loop
     unique_ptr<ast::Statement> ParseStatement()  // NOLINT
     {
         const auto& tok = lexer_.CurrentToken();
@@ -410,6 +499,12 @@ private:
         if (tok.Is<TokenType::If>()) {
             return ParseCondition();
         }
+        if (tok.Is<TokenType::While>()) {
+            return ParseWhile();
+        }
+        if (tok.Is<TokenType::For>()) {
+            return ParseFor();
+        }
         auto result = ParseSimpleStatement();
         lexer_.Expect<TokenType::Newline>();
         lexer_.NextToken();
@@ -418,6 +513,8 @@ private:
 
     // StatementBody -> return Expression
     //               | print ExpressionList
+    //               | break
+    //               | continue
     //               | AssignmentOrCall
     unique_ptr<ast::Statement> ParseSimpleStatement() {
         const auto& tok = lexer_.CurrentToken();
@@ -434,15 +531,77 @@ private:
             }
             return make_unique<ast::Print>(std::move(args));
         }
+        if (tok.Is<TokenType::Break>() || tok.Is<TokenType::Continue>()) {
+            const bool is_break = tok.Is<TokenType::Break>();
+            if (loop_depth_ == 0) {
+                throw ParseError(is_break ? "'break' outside loop"s : "'continue' outside loop"s);
+            }
+            lexer_.NextToken();
+            if (is_break) {
+                return make_unique<ast::Break>();
+            }
+            return make_unique<ast::Continue>();
+        }
         return ParseAssignmentOrCall();
     }
 
     parse::Lexer& lexer_;
     runtime::Closure declared_classes_;
+    bool pending_newline_ = false;
+    // Число циклов, внутри которых находится разбираемая инструкция
+    int loop_depth_ = 0;
 };
 
 }  // namespace
 
-unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
-    return Parser{lexer}.ParseProgram();
-}
\ No newline at end of file
+unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer) {
+    // Узлы программы размещаются подряд в одной арене и освобождаются вместе с ней
+    auto arena = make_shared<ast::Arena>();
+    unique_ptr<ast::Statement> body;
+    {
+        ast::ArenaScope scope(arena);
+        body = Parser{lexer}.ParseProgram();
+        ast::FoldConstants(body);
+    }
+    return make_unique<ast::Program>(move(arena), move(body));
+}
+namespace parse {
+
+class StatementReader::Impl {
+public:
+    explicit Impl(Lexer& lexer)
+        : parser(lexer) {
+    }
+
+    Parser parser;
+};
+
+StatementReader::StatementReader(Lexer& lexer)
+    : impl_(make_unique<Impl>(lexer)) {
+}
+
+StatementReader::StatementReader(StatementReader&&) noexcept = default;
+
+StatementReader& StatementReader::operator=(StatementReader&&) noexcept = default;
+
+StatementReader::~StatementReader() = default;
+
+unique_ptr<ast::Statement> StatementReader::Next() {
+    // Инструкции обычно невелики, поэтому им хватает маленькой арены. Арена класса
+    // живёт, пока живут его методы, так что лишняя память в ней не задерживается
+    auto arena = make_shared<ast::Arena>(STATEMENT_ARENA_BLOCK_SIZE);
+    unique_ptr<ast::Statement> body;
+    {
+        ast::ArenaScope scope(arena);
+        body = impl_->parser.ParseNextStatement();
+        if (body) {
+            ast::FoldConstants(body);
+        }
+    }
+    if (!body) {
+        return nullptr;
+    }
+    return make_unique<ast::Program>(move(arena), move(body));
+}
+
+}  // namespace parse
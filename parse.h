@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <stdexcept>
 
@@ -7,12 +8,39 @@ namespace parse {
 class Lexer;
 }
 
-namespace runtime {
-class Executable;
+namespace ast {
+class Statement;
 }
 
 struct ParseError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+// Возвращает ast::Program, узлы которой размещены в её арене
+std::unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer);
+
+namespace parse {
+
+// Разбирает программу по одной инструкции верхнего уровня, читая из лексера
+// только строки очередной инструкции. Так программу можно выполнять,
+// не дожидаясь конца ввода, а память под уже выполненные инструкции освобождать
+class StatementReader {
+public:
+    static constexpr size_t STATEMENT_ARENA_BLOCK_SIZE = 4 * 1024;
+
+    explicit StatementReader(Lexer& lexer);
+    StatementReader(StatementReader&&) noexcept;
+    StatementReader& operator=(StatementReader&&) noexcept;
+    ~StatementReader();
+
+    // Возвращает следующую инструкцию в виде ast::Program с собственной ареной
+    // либо nullptr, если программа закончилась. Арена освобождается вместе с инструкцией,
+    // если на неё не ссылаются методы объявленного в инструкции класса
+    std::unique_ptr<ast::Statement> Next();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace parse
@@ -2,6 +2,7 @@
 #include "parse.h"
 #include "statement.h"
 #include "test_runner_p.h"
+#include "vm.h"
 
 using namespace std;
 
@@ -13,6 +14,17 @@ unique_ptr<ast::Statement> ParseProgramFromString(const string& program) {
     return ParseProgram(lexer);
 }
 
+// Разбирает и выполняет программу обходом дерева либо на виртуальной машине.
+// Тесты программ проходят на обоих движках, и результаты должны совпадать
+void RunProgramFromString(const string& program, runtime::Closure& closure, runtime::Context& context, bool use_vm) {
+    auto tree = ParseProgramFromString(program);
+    if (use_vm) {
+        vm::RunProgram(*tree, closure, context);
+    } else {
+        tree->Execute(closure, context);
+    }
+}
+
 void TestSimpleProgram() {
     const string program = R"(
 x = 4
@@ -22,13 +34,13 @@ n = "world"
 print x + y, z + n
 )"s;
 
-    runtime::DummyContext context;
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
 
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "9 hello, world\n"s);
+        ASSERT_EQUAL(context.output.str(), "9 hello, world\n"s);
+    }
 }
 
 void TestProgramWithClasses() {
@@ -60,13 +72,13 @@ far_far_away = Point(10000, 50000)
 print program_name, origin, far_far_away, origin.SetX(1)
 )"s;
 
-    runtime::DummyContext context;
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
 
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "Classes test (0; 0) (10000; 50000) None\n"s);
+        ASSERT_EQUAL(context.output.str(), "Classes test (0; 0) (10000; 50000) None\n"s);
+    }
 }
 
 void TestProgramWithIf() {
@@ -86,13 +98,13 @@ else:
   print 'x <= 0'
 )"s;
 
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
 
-    ASSERT_EQUAL(context.output.str(), "x <= y\ny >= 0\n"s);
+        ASSERT_EQUAL(context.output.str(), "x <= y\ny >= 0\n"s);
+    }
 }
 
 void TestReturnFromIf() {
@@ -109,13 +121,13 @@ print x.calc(2)
 print x.calc(-32)
 )"s;
 
-    runtime::DummyContext context;
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
 
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "2\n32\n"s);
+        ASSERT_EQUAL(context.output.str(), "2\n32\n"s);
+    }
 }
 
 void TestRecursion() {
@@ -136,13 +148,13 @@ x.calc(10)
 print x.result
 )"s;
 
-    runtime::DummyContext context;
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
 
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
-
-    ASSERT_EQUAL(context.output.str(), "55\n"s);
+        ASSERT_EQUAL(context.output.str(), "55\n"s);
+    }
 }
 
 void TestRecursion2() {
@@ -165,13 +177,13 @@ print x.calc(22, 17)
 print x.call_count
 )"s;
 
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
 
-    ASSERT_EQUAL(context.output.str(), "17\n1\n115\n"s);
+        ASSERT_EQUAL(context.output.str(), "17\n1\n115\n"s);
+    }
 }
 
 void TestComplexLogicalExpression() {
@@ -183,13 +195,13 @@ ok = a + b > c and a + c > b and b + c > a
 print ok
 )"s;
 
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
 
-    ASSERT_EQUAL(context.output.str(), "False\n"s);
+        ASSERT_EQUAL(context.output.str(), "False\n"s);
+    }
 }
 
 void TestClassicalPolymorphism() {
@@ -235,14 +247,14 @@ t2 = Triangle(125, 1, 2)
 print r, c, t1, t2
 )"s;
 
-    runtime::DummyContext context;
-
-    runtime::Closure closure;
-    auto tree = ParseProgramFromString(program);
-    tree->Execute(closure, context);
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
 
-    ASSERT_EQUAL(context.output.str(),
-                 "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
+        ASSERT_EQUAL(context.output.str(),
+                     "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
+    }
 }
 
 void TestSelfInConstructor() {
@@ -257,14 +269,131 @@ xh = XHolder()
 x = X(xh)
 )--");
 
+    for (bool use_vm : {false, true}) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgramFromString(program, closure, context, use_vm);
+
+        const auto* xh = closure.at("xh"s).TryAs<runtime::ClassInstance>();
+        ASSERT(xh != nullptr);
+        ASSERT_EQUAL(xh->Fields().at("x"s).Get(), closure.at("x"s).Get());
+    }
+}
+
+void TestMethodLocals() {
+    const string program = R"(
+class Counter:
+  def __init__(start):
+    self.value = start
+
+  def add(step):
+    total = self.value
+    if step > 0:
+      tmp = step
+      total = total + tmp
+    self.value = total
+    return total
+
+  def local_class():
+    class Inner:
+      def get():
+        return 7
+    inner = Inner
+    return inner
+
+c = Counter(10)
+c.add(5)
+c.add(0)
+print c.add(1), c.value, c.local_class()
+)"s;
+
     runtime::DummyContext context;
     runtime::Closure closure;
     auto tree = ParseProgramFromString(program);
     tree->Execute(closure, context);
 
-    const auto* xh = closure.at("xh"s).TryAs<runtime::ClassInstance>();
-    ASSERT(xh != nullptr);
-    ASSERT_EQUAL(xh->Fields().at("x"s).Get(), closure.at("x"s).Get());
+    ASSERT_EQUAL(context.output.str(), "16 16 Class Inner\n"s);
+
+    const auto* counter = closure.at("c"s).TryAs<runtime::ClassInstance>();
+    ASSERT(counter != nullptr);
+    // step, self, total, tmp
+    ASSERT_EQUAL(counter->GetClass().GetMethod("add"s)->frame_size, 4U);
+    // self
+    ASSERT_EQUAL(counter->GetClass().GetMethod("local_class"s)->frame_size, 2U);
+}
+
+void TestProgramArena() {
+    const string program = R"(
+class Greeter:
+  def greet(name):
+    return "Hello, " + name + "!"
+
+g = Greeter()
+)"s;
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    {
+        auto tree = ParseProgramFromString(program);
+        const auto* root = dynamic_cast<const ast::Program*>(tree.get());
+        ASSERT(root != nullptr);
+        ASSERT(root->GetArena() != nullptr && root->GetArena()->GetAllocatedBytes() > 0);
+        tree->Execute(closure, context);
+    }
+
+    // Методы класса остаются доступны после разрушения программы и её арены
+    auto* greeter = closure.at("g"s).TryAs<runtime::ClassInstance>();
+    ASSERT(greeter != nullptr);
+    auto result = greeter->Call("greet"s, {runtime::ObjectHolder::Own(runtime::String{"arena"s})}, context);
+    ASSERT_EQUAL(result.TryAs<runtime::String>()->GetValue(), "Hello, arena!"s);
+}
+
+void TestStatementReader() {
+    istringstream input(R"(x = 2
+class Doubler:
+  def apply(n):
+    return n * 2
+
+d = Doubler()
+print d.apply(x)
+)"s);
+    parse::Lexer lexer(input);
+    StatementReader reader(lexer);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+
+    // Первая инструкция возвращается, пока остальные строки не прочитаны
+    auto statement = reader.Next();
+    ASSERT(statement != nullptr);
+    ASSERT_EQUAL(input.tellg(), istream::pos_type(6));
+    statement->Execute(closure, context);
+
+    // Инструкция с объявлением класса освобождается, а методы класса остаются доступны
+    size_t count = 1;
+    while ((statement = reader.Next()) != nullptr) {
+        statement->Execute(closure, context);
+        statement.reset();
+        ++count;
+    }
+    ASSERT_EQUAL(count, 4U);
+    ASSERT_EQUAL(context.output.str(), "4\n"s);
+    ASSERT(reader.Next() == nullptr);
+}
+
+void TestLoopErrors() {
+    ASSERT_THROWS(ParseProgramFromString("break\n"s), ParseError);
+    ASSERT_THROWS(ParseProgramFromString("if True:\n  continue\n"s), ParseError);
+    // break в методе не относится к циклу, внутри которого объявлен класс
+    ASSERT_THROWS(ParseProgramFromString("while True:\n  class A:\n    def f():\n      break\n"s), ParseError);
+    ASSERT_THROWS(ParseProgramFromString("for i in range():\n  print i\n"s), ParseError);
+    ASSERT_THROWS(ParseProgramFromString("for i in range(1, 2, 3, 4):\n  print i\n"s), ParseError);
+    ASSERT_THROWS(ParseProgramFromString("for i in list(3):\n  print i\n"s), LexerError);
+
+    // range - не ключевое слово, переменную с таким именем можно объявить
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString("range = 2\nfor i in range(range):\n  print i\n"s)->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "0\n1\n"s);
 }
 
 }  // namespace parse
@@ -279,4 +408,8 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
     RUN_TEST(tr, parse::TestSelfInConstructor);
+    RUN_TEST(tr, parse::TestMethodLocals);
+    RUN_TEST(tr, parse::TestProgramArena);
+    RUN_TEST(tr, parse::TestStatementReader);
+    RUN_TEST(tr, parse::TestLoopErrors);
 }
\ No newline at end of file
@@ -0,0 +1,624 @@
+#include "program_cache.h"
+
+#include "resolver.h"
+#include "source.h"
+#include "statement.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+// Начало файла кэша. Номер версии меняется при любом изменении формата
+constexpr string_view MAGIC = "MYTHONC\0"sv;
+constexpr uint64_t FORMAT_VERSION = 3;
+constexpr string_view CACHE_EXTENSION = ".myc"sv;
+
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+constexpr uint8_t COMPARATOR_COUNT = static_cast<uint8_t>(Comparator::GreaterOrEqual) + 1;
+
+// Вид узла. Узел записывается в прямом порядке обхода: вид, затем поля и дочерние узлы
+enum class Tag : uint8_t {
+    Null,
+    Compound,
+    NumericConst,
+    StringConst,
+    BoolConst,
+    None,
+    VariableValue,
+    Assignment,
+    FieldAssignment,
+    Print,
+    MethodCall,
+    NewInstance,
+    Stringify,
+    Add,
+    Sub,
+    Mult,
+    Div,
+    Or,
+    And,
+    Not,
+    Comparison,
+    Return,
+    ClassDefinition,
+    IfElse,
+    Negate,
+    While,
+    ForRange,
+    Break,
+    Continue,
+};
+
+class Writer {
+public:
+    string Finish() && {
+        return move(out_);
+    }
+
+    void WriteByte(uint8_t value) {
+        out_.push_back(static_cast<char>(value));
+    }
+
+    // Целое без знака в 7-битных группах, младшие группы первыми
+    void WriteVarint(uint64_t value) {
+        while (value >= 0x80) {
+            WriteByte(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        WriteByte(static_cast<uint8_t>(value));
+    }
+
+    void WriteFixed64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            WriteByte(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+
+    void WriteString(string_view value) {
+        WriteVarint(value.size());
+        out_.append(value);
+    }
+
+    void WriteStatement(const Statement* statement) {
+        if (statement == nullptr) {
+            WriteTag(Tag::Null);
+        } else if (const auto* compound = dynamic_cast<const Compound*>(statement)) {
+            WriteTag(Tag::Compound);
+            WriteList(compound->GetStatements());
+        } else if (const auto* num = dynamic_cast<const NumericConst*>(statement)) {
+            WriteTag(Tag::NumericConst);
+            // Отрицательные числа кодируются зигзагом, чтобы не занимать 10 байт
+            const auto value = static_cast<int64_t>(num->GetValue().GetValue());
+            WriteVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        } else if (const auto* str = dynamic_cast<const StringConst*>(statement)) {
+            WriteTag(Tag::StringConst);
+            WriteString(str->GetValue().GetValue());
+        } else if (const auto* b = dynamic_cast<const BoolConst*>(statement)) {
+            WriteTag(Tag::BoolConst);
+            WriteByte(b->GetValue().GetValue() ? 1 : 0);
+        } else if (dynamic_cast<const None*>(statement) != nullptr) {
+            WriteTag(Tag::None);
+        } else if (const auto* var = dynamic_cast<const VariableValue*>(statement)) {
+            WriteTag(Tag::VariableValue);
+            WriteDottedIds(*var);
+        } else if (const auto* assignment = dynamic_cast<const Assignment*>(statement)) {
+            WriteTag(Tag::Assignment);
+            WriteSymbol(assignment->GetVar());
+            WriteStatement(&assignment->GetValue());
+        } else if (const auto* field = dynamic_cast<const FieldAssignment*>(statement)) {
+            WriteTag(Tag::FieldAssignment);
+            WriteDottedIds(field->GetObject());
+            WriteSymbol(field->GetFieldName());
+            WriteStatement(&field->GetValue());
+        } else if (const auto* print = dynamic_cast<const Print*>(statement)) {
+            WriteTag(Tag::Print);
+            WriteList(print->GetArgs());
+        } else if (const auto* call = dynamic_cast<const MethodCall*>(statement)) {
+            WriteTag(Tag::MethodCall);
+            WriteStatement(&call->GetObject());
+            WriteSymbol(call->GetMethod());
+            WriteList(call->GetArgs());
+        } else if (const auto* instance = dynamic_cast<const NewInstance*>(statement)) {
+            WriteTag(Tag::NewInstance);
+            const auto it = classes_.find(&instance->GetClass());
+            if (it == classes_.end()) {
+                throw CacheError("Class "s + instance->GetClass().GetName() + " is not defined in the program"s);
+            }
+            WriteVarint(it->second);
+            WriteList(instance->GetArgs());
+        } else if (const auto* stringify = dynamic_cast<const Stringify*>(statement)) {
+            WriteTag(Tag::Stringify);
+            WriteStatement(&stringify->GetArgument());
+        } else if (const auto* op_not = dynamic_cast<const Not*>(statement)) {
+            WriteTag(Tag::Not);
+            WriteStatement(&op_not->GetArgument());
+        } else if (const auto* negate = dynamic_cast<const Negate*>(statement)) {
+            WriteTag(Tag::Negate);
+            WriteStatement(&negate->GetArgument());
+        } else if (const auto* add = dynamic_cast<const Add*>(statement)) {
+            WriteBinary(Tag::Add, *add);
+        } else if (const auto* sub = dynamic_cast<const Sub*>(statement)) {
+            WriteBinary(Tag::Sub, *sub);
+        } else if (const auto* mult = dynamic_cast<const Mult*>(statement)) {
+            WriteBinary(Tag::Mult, *mult);
+        } else if (const auto* div = dynamic_cast<const Div*>(statement)) {
+            WriteBinary(Tag::Div, *div);
+        } else if (const auto* op_or = dynamic_cast<const Or*>(statement)) {
+            WriteBinary(Tag::Or, *op_or);
+        } else if (const auto* op_and = dynamic_cast<const And*>(statement)) {
+            WriteBinary(Tag::And, *op_and);
+        } else if (const auto* cmp = dynamic_cast<const Comparison*>(statement)) {
+            WriteBinary(Tag::Comparison, *cmp);
+            WriteByte(static_cast<uint8_t>(cmp->GetComparator()));
+        } else if (const auto* ret = dynamic_cast<const Return*>(statement)) {
+            WriteTag(Tag::Return);
+            WriteStatement(&ret->GetStatement());
+        } else if (const auto* definition = dynamic_cast<const ClassDefinition*>(statement)) {
+            WriteTag(Tag::ClassDefinition);
+            WriteClass(*static_cast<const runtime::Class*>(definition->GetClass().Get()));
+        } else if (const auto* if_else = dynamic_cast<const IfElse*>(statement)) {
+            WriteTag(Tag::IfElse);
+            WriteStatement(&if_else->GetCondition());
+            WriteStatement(&if_else->GetIfBody());
+            WriteStatement(if_else->GetElseBody());
+        } else if (const auto* loop = dynamic_cast<const While*>(statement)) {
+            WriteTag(Tag::While);
+            WriteStatement(&loop->GetCondition());
+            WriteStatement(&loop->GetBody());
+        } else if (const auto* loop = dynamic_cast<const ForRange*>(statement)) {
+            WriteTag(Tag::ForRange);
+            WriteSymbol(loop->GetVar());
+            WriteStatement(&loop->GetStart());
+            WriteStatement(&loop->GetStop());
+            WriteStatement(&loop->GetStep());
+            WriteStatement(&loop->GetBody());
+        } else if (dynamic_cast<const Break*>(statement) != nullptr) {
+            WriteTag(Tag::Break);
+        } else if (dynamic_cast<const Continue*>(statement) != nullptr) {
+            WriteTag(Tag::Continue);
+        } else {
+            throw CacheError("Unsupported statement"s);
+        }
+    }
+
+private:
+    void WriteTag(Tag tag) {
+        WriteByte(static_cast<uint8_t>(tag));
+    }
+
+    // Имя записывается целиком при первом упоминании, затем - только номером
+    void WriteSymbol(runtime::Symbol symbol) {
+        const auto [it, inserted] = symbols_.emplace(symbol, static_cast<uint32_t>(symbols_.size()));
+        WriteVarint(it->second);
+        if (inserted) {
+            WriteString(symbol.Str());
+        }
+    }
+
+    void WriteList(const vector<unique_ptr<Statement>>& statements) {
+        WriteVarint(statements.size());
+        for (const auto& statement : statements) {
+            WriteStatement(statement.get());
+        }
+    }
+
+    void WriteDottedIds(const VariableValue& var) {
+        const auto& ids = var.GetDottedIds();
+        WriteVarint(ids.size());
+        for (runtime::Symbol id : ids) {
+            WriteSymbol(id);
+        }
+    }
+
+    void WriteBinary(Tag tag, const BinaryOperation& operation) {
+        WriteTag(tag);
+        WriteStatement(&operation.GetLhs());
+        WriteStatement(&operation.GetRhs());
+    }
+
+    // Класс получает номер в порядке объявления, по нему на класс ссылаются NewInstance и потомки
+    void WriteClass(const runtime::Class& cls) {
+        WriteString(cls.GetName());
+        if (const runtime::Class* parent = cls.GetParent()) {
+            const auto it = classes_.find(parent);
+            if (it == classes_.end()) {
+                throw CacheError("Base class "s + parent->GetName() + " is not defined in the program"s);
+            }
+            WriteVarint(it->second + 1);
+        } else {
+            WriteVarint(0);
+        }
+
+        WriteVarint(cls.GetMethods().size());
+        for (const runtime::Method& method : cls.GetMethods()) {
+            WriteSymbol(method.name);
+            WriteVarint(method.formal_params.size());
+            for (runtime::Symbol param : method.formal_params) {
+                WriteSymbol(param);
+            }
+            const auto* body = dynamic_cast<const MethodBody*>(method.body.get());
+            if (body == nullptr) {
+                throw CacheError("Unsupported body of method "s + method.name.Str());
+            }
+            WriteStatement(&body->GetBody());
+        }
+        classes_.emplace(&cls, static_cast<uint32_t>(classes_.size()));
+    }
+
+    string out_;
+    unordered_map<runtime::Symbol, uint32_t> symbols_;
+    unordered_map<const runtime::Class*, uint32_t> classes_;
+};
+
+class Reader {
+public:
+    explicit Reader(string_view data)
+        : data_(data) {
+    }
+
+    [[nodiscard]] bool AtEnd() const {
+        return pos_ == data_.size();
+    }
+
+    uint8_t ReadByte() {
+        if (pos_ >= data_.size()) {
+            Fail();
+        }
+        return static_cast<uint8_t>(data_[pos_++]);
+    }
+
+    uint64_t ReadVarint() {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t byte = ReadByte();
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return result;
+            }
+        }
+        Fail();
+    }
+
+    uint64_t ReadFixed64() {
+        uint64_t result = 0;
+        for (int i = 0; i < 8; ++i) {
+            result |= static_cast<uint64_t>(ReadByte()) << (i * 8);
+        }
+        return result;
+    }
+
+    string_view ReadBytes(uint64_t size) {
+        if (size > data_.size() - pos_) {
+            Fail();
+        }
+        const string_view result = data_.substr(pos_, size);
+        pos_ += size;
+        return result;
+    }
+
+    string_view ReadString() {
+        return ReadBytes(ReadVarint());
+    }
+
+    unique_ptr<Statement> ReadStatement() {
+        switch (static_cast<Tag>(ReadByte())) {
+            case Tag::Null:
+                return nullptr;
+            case Tag::Compound: {
+                auto result = make_unique<Compound>();
+                for (auto& statement : ReadList()) {
+                    result->AddStatement(move(statement));
+                }
+                return result;
+            }
+            case Tag::NumericConst: {
+                const uint64_t value = ReadVarint();
+                const auto decoded = static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+                return make_unique<NumericConst>(runtime::Number{static_cast<int>(decoded)});
+            }
+            case Tag::StringConst:
+                return make_unique<StringConst>(runtime::String{string(ReadString())});
+            case Tag::BoolConst:
+                return make_unique<BoolConst>(runtime::Bool{ReadByte() != 0});
+            case Tag::None:
+                return make_unique<None>();
+            case Tag::VariableValue:
+                return make_unique<VariableValue>(ReadDottedIds());
+            case Tag::Assignment: {
+                const runtime::Symbol var = ReadSymbol();
+                return make_unique<Assignment>(var, ReadRequired());
+            }
+            case Tag::FieldAssignment: {
+                VariableValue object(ReadDottedIds());
+                const runtime::Symbol field_name = ReadSymbol();
+                return make_unique<FieldAssignment>(move(object), field_name, ReadRequired());
+            }
+            case Tag::Print:
+                return make_unique<Print>(ReadList());
+            case Tag::MethodCall: {
+                auto object = ReadRequired();
+                const runtime::Symbol method = ReadSymbol();
+                return make_unique<MethodCall>(move(object), method, ReadList());
+            }
+            case Tag::NewInstance: {
+                const runtime::Class& cls = ReadClassRef();
+                return make_unique<NewInstance>(cls, ReadList());
+            }
+            case Tag::Stringify:
+                return make_unique<Stringify>(ReadRequired());
+            case Tag::Not:
+                return make_unique<Not>(ReadRequired());
+            case Tag::Negate:
+                return make_unique<Negate>(ReadRequired());
+            case Tag::Add:
+                return ReadBinary<Add>();
+            case Tag::Sub:
+                return ReadBinary<Sub>();
+            case Tag::Mult:
+                return ReadBinary<Mult>();
+            case Tag::Div:
+                return ReadBinary<Div>();
+            case Tag::Or:
+                return ReadBinary<Or>();
+            case Tag::And:
+                return ReadBinary<And>();
+            case Tag::Comparison: {
+                auto lhs = ReadRequired();
+                auto rhs = ReadRequired();
+                const uint8_t index = ReadByte();
+                if (index >= COMPARATOR_COUNT) {
+                    Fail();
+                }
+                return MakeComparison(static_cast<Comparator>(index), move(lhs), move(rhs));
+            }
+            case Tag::Return:
+                return make_unique<Return>(ReadRequired());
+            case Tag::ClassDefinition:
+                return ReadClassDefinition();
+            case Tag::IfElse: {
+                auto condition = ReadRequired();
+                auto if_body = ReadRequired();
+                return make_unique<IfElse>(move(condition), move(if_body), ReadStatement());
+            }
+            case Tag::While: {
+                auto condition = ReadRequired();
+                return make_unique<While>(move(condition), ReadRequired());
+            }
+            case Tag::ForRange: {
+                const runtime::Symbol var = ReadSymbol();
+                auto start = ReadRequired();
+                auto stop = ReadRequired();
+                auto step = ReadRequired();
+                return make_unique<ForRange>(var, move(start), move(stop), move(step), ReadRequired());
+            }
+            case Tag::Break:
+                return make_unique<Break>();
+            case Tag::Continue:
+                return make_unique<Continue>();
+        }
+        Fail();
+    }
+
+private:
+    [[noreturn]] static void Fail() {
+        throw CacheError("Program cache is corrupted"s);
+    }
+
+    unique_ptr<Statement> ReadRequired() {
+        auto result = ReadStatement();
+        if (!result) {
+            Fail();
+        }
+        return result;
+    }
+
+    // Количество элементов не может превышать число оставшихся байт,
+    // поэтому испорченная длина не приводит к огромному выделению памяти
+    size_t ReadCount() {
+        const uint64_t count = ReadVarint();
+        if (count > data_.size() - pos_) {
+            Fail();
+        }
+        return static_cast<size_t>(count);
+    }
+
+    vector<unique_ptr<Statement>> ReadList() {
+        vector<unique_ptr<Statement>> result(ReadCount());
+        for (auto& statement : result) {
+            statement = ReadRequired();
+        }
+        return result;
+    }
+
+    runtime::Symbol ReadSymbol() {
+        const uint64_t index = ReadVarint();
+        if (index == symbols_.size()) {
+            symbols_.emplace_back(ReadString());
+        } else if (index > symbols_.size()) {
+            Fail();
+        }
+        return symbols_[index];
+    }
+
+    vector<runtime::Symbol> ReadDottedIds() {
+        vector<runtime::Symbol> result(ReadCount());
+        if (result.empty()) {
+            Fail();
+        }
+        for (auto& id : result) {
+            id = ReadSymbol();
+        }
+        return result;
+    }
+
+    template <typename Operation>
+    unique_ptr<Statement> ReadBinary() {
+        auto lhs = ReadRequired();
+        return make_unique<Operation>(move(lhs), ReadRequired());
+    }
+
+    const runtime::Class& ReadClassRef() {
+        const uint64_t index = ReadVarint();
+        if (index >= classes_.size()) {
+            Fail();
+        }
+        return *classes_[index];
+    }
+
+    unique_ptr<Statement> ReadClassDefinition() {
+        string name(ReadString());
+        const runtime::Class* parent = nullptr;
+        if (const uint64_t parent_index = ReadVarint(); parent_index != 0) {
+            if (parent_index > classes_.size()) {
+                Fail();
+            }
+            parent = classes_[parent_index - 1];
+        }
+
+        vector<runtime::Method> methods(ReadCount());
+        for (runtime::Method& method : methods) {
+            method.name = ReadSymbol();
+            method.formal_params.resize(ReadCount());
+            for (auto& param : method.formal_params) {
+                param = ReadSymbol();
+            }
+            method.body = make_unique<MethodBody>(ReadRequired());
+            ResolveSlots(method);
+        }
+
+        auto cls = runtime::ObjectHolder::Own(runtime::Class(move(name), move(methods), parent));
+        classes_.push_back(static_cast<const runtime::Class*>(cls.Get()));
+        return make_unique<ClassDefinition>(move(cls));
+    }
+
+    string_view data_;
+    size_t pos_ = 0;
+    vector<runtime::Symbol> symbols_;
+    vector<const runtime::Class*> classes_;
+};
+
+string ToHex(uint64_t value) {
+    static constexpr string_view DIGITS = "0123456789abcdef"sv;
+    string result(16, '0');
+    for (auto it = result.rbegin(); it != result.rend(); ++it, value >>= 4) {
+        *it = DIGITS[value & 0xf];
+    }
+    return result;
+}
+
+}  // namespace
+
+uint64_t HashSource(string_view text) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const char c : text) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+string SerializeProgram(const runtime::Executable& program) {
+    const auto* statement = dynamic_cast<const Statement*>(&program);
+    if (const auto* root = dynamic_cast<const Program*>(statement)) {
+        statement = &root->GetBody();
+    }
+    if (statement == nullptr) {
+        throw CacheError("Unsupported statement"s);
+    }
+    Writer writer;
+    writer.WriteStatement(statement);
+    return move(writer).Finish();
+}
+
+unique_ptr<Statement> DeserializeProgram(string_view data) {
+    auto arena = make_shared<Arena>();
+    unique_ptr<Statement> body;
+    {
+        ArenaScope scope(arena);
+        // Узлы удаляются внутри области арены, даже если данные оказались испорчены
+        Reader reader(data);
+        auto result = reader.ReadStatement();
+        if (!result || !reader.AtEnd()) {
+            throw CacheError("Program cache is corrupted"s);
+        }
+        body = move(result);
+    }
+    return make_unique<Program>(move(arena), move(body));
+}
+
+ProgramCache::ProgramCache(string directory, string_view source)
+    : directory_(move(directory))
+    , source_hash_(HashSource(source))
+    , source_size_(source.size()) {
+    path_ = (filesystem::path(directory_) / (ToHex(source_hash_) + string(CACHE_EXTENSION))).string();
+}
+
+unique_ptr<Statement> ProgramCache::Load() const {
+    error_code error;
+    if (!filesystem::is_regular_file(path_, error)) {
+        return nullptr;
+    }
+
+    try {
+        const auto file = parse::SourceBuffer::FromFile(path_);
+        Reader reader(file.GetText());
+        if (reader.ReadBytes(MAGIC.size()) != MAGIC || reader.ReadVarint() != FORMAT_VERSION
+            || reader.ReadFixed64() != source_hash_ || reader.ReadVarint() != source_size_) {
+            return nullptr;
+        }
+        const uint64_t payload_hash = reader.ReadFixed64();
+        const string_view payload = reader.ReadString();
+        if (!reader.AtEnd() || HashSource(payload) != payload_hash) {
+            return nullptr;
+        }
+        return DeserializeProgram(payload);
+    } catch (const std::runtime_error&) {
+        // Нечитаемый или повреждённый файл считается промахом кэша
+        return nullptr;
+    }
+}
+
+void ProgramCache::Store(const runtime::Executable& program) const {
+    const string payload = SerializeProgram(program);
+
+    Writer header;
+    for (const char c : MAGIC) {
+        header.WriteByte(static_cast<uint8_t>(c));
+    }
+    header.WriteVarint(FORMAT_VERSION);
+    header.WriteFixed64(source_hash_);
+    header.WriteVarint(source_size_);
+    header.WriteFixed64(HashSource(payload));
+    header.WriteVarint(payload.size());
+    const string prefix = move(header).Finish();
+
+    error_code error;
+    filesystem::create_directories(directory_, error);
+
+    const string temp_path = path_ + ".tmp"s + ToHex(random_device{}());
+    {
+        ofstream out(temp_path, ios::binary | ios::trunc);
+        out.write(prefix.data(), static_cast<streamsize>(prefix.size()));
+        out.write(payload.data(), static_cast<streamsize>(payload.size()));
+        out.close();
+        if (!out) {
+            filesystem::remove(temp_path, error);
+            throw CacheError("Cannot write program cache "s + temp_path);
+        }
+    }
+    filesystem::rename(temp_path, path_, error);
+    if (error) {
+        filesystem::remove(temp_path, error);
+        throw CacheError("Cannot write program cache "s + path_);
+    }
+}
+
+}  // namespace ast
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace ast {
+
+class Statement;
+
+// Выбрасывается, если программу нельзя сохранить в кэш или данные кэша повреждены
+class CacheError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Возвращает 64-битный хэш FNV-1a строки text
+std::uint64_t HashSource(std::string_view text);
+
+// Записывает дерево программы, которую вернул ParseProgram, в компактном двоичном виде.
+// Имена записываются один раз и дальше упоминаются по номеру.
+// Выбрасывает CacheError, если в дереве есть узлы, которые не создаёт парсер
+std::string SerializeProgram(const runtime::Executable& program);
+
+// Восстанавливает программу из данных SerializeProgram. Узлы размещаются в новой арене,
+// как у ParseProgram, слоты методов назначаются заново.
+// Выбрасывает CacheError, если данные повреждены
+std::unique_ptr<Statement> DeserializeProgram(std::string_view data);
+
+/*
+ * Кэш разобранной программы в каталоге directory. Имя файла - хэш текста программы,
+ * а в самом файле, кроме дерева, записаны длина и хэш текста и хэш данных. Поэтому
+ * устаревший или повреждённый файл не загружается, а перезаписывается при сохранении.
+ * Файл загружается отображением в память, лексер и парсер при этом не нужны
+ */
+class ProgramCache {
+public:
+    ProgramCache(std::string directory, std::string_view source);
+
+    // Путь к файлу кэша программы
+    [[nodiscard]] const std::string& GetPath() const {
+        return path_;
+    }
+
+    // Возвращает программу из кэша либо nullptr, если подходящего файла нет
+    [[nodiscard]] std::unique_ptr<Statement> Load() const;
+
+    // Сохраняет программу в кэш. Файл сначала пишется под временным именем и затем
+    // переименовывается, поэтому одновременные запуски не видят его недописанным.
+    // Выбрасывает CacheError, если программу нельзя сохранить
+    void Store(const runtime::Executable& program) const;
+
+private:
+    std::string directory_;
+    std::string path_;
+    std::uint64_t source_hash_;
+    std::uint64_t source_size_;
+};
+
+}  // namespace ast
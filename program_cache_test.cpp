@@ -0,0 +1,135 @@
+#include "lexer.h"
+#include "parse.h"
+#include "program_cache.h"
+#include "statement.h"
+#include "test_runner_p.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+
+const string PROGRAM = R"(
+class Shape:
+  def __init__(name):
+    self.name = name
+
+  def __str__():
+    return "Shape " + self.name
+
+  def area():
+    return 0
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.name = 'rect'
+    self.w = w
+    self.h = h
+
+  def area():
+    result = self.w * self.h
+    return result
+
+  def scale(k, times):
+    if times == 0:
+      return self.area()
+    self.w = self.w * k
+    return self.scale(k, times - 1)
+
+r = Rect(3, -4)
+s = Shape("none")
+print r, s, r.area(), s.area(), None
+if r.area() < 0 and not r.w >= 4 or False:
+  print 'negative', 10 / 3 - 1
+else:
+  print 'positive'
+print r.w == 3, r.h != 3, r.w <= 3, r.h > 3, str(r.w + r.h)
+r.w = 5
+print r.area(), r.scale(2, 3)
+total = 0
+for i in range(1, 10, 2):
+  while total < i:
+    total = total + 3
+    if total == 6:
+      continue
+    if total > 20:
+      break
+print total
+)"s;
+
+unique_ptr<Statement> Parse(const string& program) {
+    istringstream input(program);
+    parse::Lexer lexer(input);
+    return ParseProgram(lexer);
+}
+
+string Run(runtime::Executable& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program.Execute(closure, context);
+    return context.output.str();
+}
+
+void TestRoundTrip() {
+    auto parsed = Parse(PROGRAM);
+    const string data = SerializeProgram(*parsed);
+    auto loaded = DeserializeProgram(data);
+
+    ASSERT_EQUAL(Run(*loaded), Run(*parsed));
+    ASSERT_EQUAL(SerializeProgram(*loaded), data);
+    // Повторяющиеся имена записываются один раз, поэтому данные компактнее текста
+    ASSERT(data.size() < PROGRAM.size());
+}
+
+void TestCorruptedDataIsRejected() {
+    const string data = SerializeProgram(*Parse(PROGRAM));
+    for (size_t size = 0; size < data.size(); ++size) {
+        ASSERT_THROWS(DeserializeProgram(string_view{data}.substr(0, size)), CacheError);
+    }
+    ASSERT_THROWS(DeserializeProgram(data + "\0"s), CacheError);
+    ASSERT_THROWS(DeserializeProgram("\xff"s), CacheError);
+}
+
+void TestProgramCache() {
+    const auto directory = filesystem::temp_directory_path() / "mython_program_cache_test"s;
+    filesystem::remove_all(directory);
+
+    const ProgramCache cache(directory.string(), PROGRAM);
+    ASSERT(cache.Load() == nullptr);
+
+    auto parsed = Parse(PROGRAM);
+    cache.Store(*parsed);
+    auto loaded = cache.Load();
+    ASSERT(loaded != nullptr);
+    ASSERT_EQUAL(Run(*loaded), Run(*parsed));
+
+    // Другой текст программы не находит чужой файл кэша
+    const string other = PROGRAM + "print 1\n"s;
+    ASSERT(ProgramCache(directory.string(), other).Load() == nullptr);
+
+    // Испорченный файл считается промахом кэша и перезаписывается при сохранении
+    {
+        fstream file(cache.GetPath(), ios::in | ios::out | ios::binary);
+        file.seekp(-1, ios::end);
+        file.put('\x7f');
+    }
+    ASSERT(cache.Load() == nullptr);
+    cache.Store(*parsed);
+    ASSERT(cache.Load() != nullptr);
+
+    filesystem::remove_all(directory);
+}
+
+}  // namespace
+
+void RunProgramCacheTests(TestRunner& tr) {
+    RUN_TEST(tr, ast::TestRoundTrip);
+    RUN_TEST(tr, ast::TestCorruptedDataIsRejected);
+    RUN_TEST(tr, ast::TestProgramCache);
+}
+
+}  // namespace ast
@@ -0,0 +1,197 @@
+#include "resolver.h"
+
+#include "statement.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+const runtime::Symbol SELF{"self"};
+
+class SlotResolver {
+public:
+    explicit SlotResolver(const runtime::Method& method) {
+        for (runtime::Symbol param : method.formal_params) {
+            AddSlot(param);
+        }
+        AddSlot(SELF);
+    }
+
+    // Собирает имена, которым внутри тела присваиваются значения
+    void CollectLocals(Statement& statement) {
+        if (auto* compound = dynamic_cast<Compound*>(&statement)) {
+            for (auto& stmt : compound->GetStatements()) {
+                CollectLocals(*stmt);
+            }
+        } else if (auto* body = dynamic_cast<MethodBody*>(&statement)) {
+            CollectLocals(*body->GetBody());
+        } else if (auto* if_else = dynamic_cast<IfElse*>(&statement)) {
+            CollectLocals(*if_else->GetIfBody());
+            if (if_else->GetElseBody()) {
+                CollectLocals(*if_else->GetElseBody());
+            }
+        } else if (auto* loop = dynamic_cast<While*>(&statement)) {
+            CollectLocals(*loop->GetBody());
+        } else if (auto* loop = dynamic_cast<ForRange*>(&statement)) {
+            assigned_.push_back(loop->GetVar());
+            CollectLocals(*loop->GetBody());
+        } else if (auto* assignment = dynamic_cast<Assignment*>(&statement)) {
+            assigned_.push_back(assignment->GetVar());
+        } else if (auto* definition = dynamic_cast<ClassDefinition*>(&statement)) {
+            dynamic_names_.insert(definition->GetClass().TryAs<runtime::Class>()->GetName());
+        }
+    }
+
+    size_t BuildFrame() {
+        for (runtime::Symbol name : assigned_) {
+            if (dynamic_names_.count(name) == 0) {
+                AddSlot(name);
+            }
+        }
+        return frame_size_;
+    }
+
+    [[nodiscard]] bool HasDynamicNames() const {
+        return !dynamic_names_.empty();
+    }
+
+    void Resolve(Statement& statement) {
+        if (auto* compound = dynamic_cast<Compound*>(&statement)) {
+            for (auto& stmt : compound->GetStatements()) {
+                Resolve(*stmt);
+            }
+        } else if (auto* body = dynamic_cast<MethodBody*>(&statement)) {
+            Resolve(*body->GetBody());
+        } else if (auto* ret = dynamic_cast<Return*>(&statement)) {
+            Resolve(*ret->GetStatement());
+        } else if (auto* if_else = dynamic_cast<IfElse*>(&statement)) {
+            Resolve(*if_else->GetCondition());
+            Resolve(*if_else->GetIfBody());
+            if (if_else->GetElseBody()) {
+                Resolve(*if_else->GetElseBody());
+            }
+        } else if (auto* loop = dynamic_cast<While*>(&statement)) {
+            Resolve(*loop->GetCondition());
+            Resolve(*loop->GetBody());
+        } else if (auto* loop = dynamic_cast<ForRange*>(&statement)) {
+            Resolve(*loop->GetStart());
+            Resolve(*loop->GetStop());
+            Resolve(*loop->GetStep());
+            Resolve(*loop->GetBody());
+            if (auto it = slots_.find(loop->GetVar()); it != slots_.end()) {
+                loop->SetSlot(it->second);
+            }
+        } else if (auto* assignment = dynamic_cast<Assignment*>(&statement)) {
+            Resolve(*assignment->GetValue());
+            if (auto it = slots_.find(assignment->GetVar()); it != slots_.end()) {
+                assignment->SetSlot(it->second);
+            }
+        } else if (auto* field = dynamic_cast<FieldAssignment*>(&statement)) {
+            Resolve(field->GetObject());
+            Resolve(*field->GetValue());
+        } else if (auto* var = dynamic_cast<VariableValue*>(&statement)) {
+            if (auto it = slots_.find(var->GetDottedIds()[0]); it != slots_.end()) {
+                var->SetSlot(it->second);
+            }
+        } else if (auto* print = dynamic_cast<Print*>(&statement)) {
+            ResolveAll(print->GetArgs());
+        } else if (auto* call = dynamic_cast<MethodCall*>(&statement)) {
+            Resolve(*call->GetObject());
+            ResolveAll(call->GetArgs());
+        } else if (auto* instance = dynamic_cast<NewInstance*>(&statement)) {
+            ResolveAll(instance->GetArgs());
+        } else if (auto* unary = dynamic_cast<UnaryOperation*>(&statement)) {
+            Resolve(*unary->GetArgument());
+        } else if (auto* binary = dynamic_cast<BinaryOperation*>(&statement)) {
+            Resolve(*binary->GetLhs());
+            Resolve(*binary->GetRhs());
+        }
+    }
+
+    // Заменяет инструкции return self.method(...), где method - метод, тело которого
+    // разрешается, узлами TailCall. Возвращает true, если замена была
+    bool MarkTailCalls(unique_ptr<Statement>& statement, const runtime::Method& method) {
+        if (auto* compound = dynamic_cast<Compound*>(statement.get())) {
+            bool marked = false;
+            for (auto& stmt : compound->GetStatements()) {
+                marked = MarkTailCalls(stmt, method) || marked;
+            }
+            return marked;
+        }
+        if (auto* if_else = dynamic_cast<IfElse*>(statement.get())) {
+            const bool marked = MarkTailCalls(if_else->GetIfBody(), method);
+            return (if_else->GetElseBody() && MarkTailCalls(if_else->GetElseBody(), method)) || marked;
+        }
+        if (auto* loop = dynamic_cast<While*>(statement.get())) {
+            return MarkTailCalls(loop->GetBody(), method);
+        }
+        if (auto* loop = dynamic_cast<ForRange*>(statement.get())) {
+            return MarkTailCalls(loop->GetBody(), method);
+        }
+        auto* ret = dynamic_cast<Return*>(statement.get());
+        if (ret == nullptr || !IsSelfCall(*ret->GetStatement(), method)) {
+            return false;
+        }
+        // Аргументы вычисляются в слоты за последней локальной переменной
+        unique_ptr<MethodCall> call{static_cast<MethodCall*>(ret->GetStatement().release())};
+        statement = make_unique<TailCall>(move(call), static_cast<const MethodBody&>(*method.body),
+                                          frame_size_);
+        return true;
+    }
+
+private:
+    bool IsSelfCall(const Statement& statement, const runtime::Method& method) const {
+        const auto* call = dynamic_cast<const MethodCall*>(&statement);
+        if (call == nullptr || call->GetMethod() != method.name
+            || call->GetArgs().size() != method.formal_params.size()) {
+            return false;
+        }
+        const auto* object = dynamic_cast<const VariableValue*>(&call->GetObject());
+        return object != nullptr && object->GetDottedIds().size() == 1 && object->GetDottedIds()[0] == SELF;
+    }
+
+    void AddSlot(runtime::Symbol name) {
+        if (slots_.emplace(name, frame_size_).second) {
+            ++frame_size_;
+        }
+    }
+
+    void ResolveAll(vector<unique_ptr<Statement>>& statements) {
+        for (auto& stmt : statements) {
+            Resolve(*stmt);
+        }
+    }
+
+    unordered_map<runtime::Symbol, size_t> slots_;
+    size_t frame_size_ = 0;
+    vector<runtime::Symbol> assigned_;
+    unordered_set<runtime::Symbol> dynamic_names_;
+};
+
+}  // namespace
+
+void ResolveSlots(runtime::Method& method) {
+    // Тела, построенные не из узлов AST, выполняются с поиском по именам
+    auto* body = dynamic_cast<Statement*>(method.body.get());
+    if (body == nullptr) {
+        return;
+    }
+    SlotResolver resolver(method);
+    resolver.CollectLocals(*body);
+    method.frame_size = resolver.BuildFrame();
+    resolver.Resolve(*body);
+
+    // Повторное выполнение тела не должно видеть классы, объявленные в прошлом вызове,
+    // поэтому хвостовые вызовы заменяются, только если все имена тела связаны со слотами
+    auto* method_body = dynamic_cast<MethodBody*>(body);
+    if (method_body != nullptr && !resolver.HasDynamicNames()
+        && resolver.MarkTailCalls(method_body->GetBody(), method)) {
+        method.frame_size += method.formal_params.size();
+    }
+}
+
+}  // namespace ast
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "runtime.h"
+
+namespace ast {
+
+/*
+ * Назначает параметрам, self и локальным переменным тела метода номера слотов кадра
+ * и записывает размер кадра в method.frame_size. Параметры занимают слоты [0, n),
+ * self - слот n, локальные переменные - следующие слоты в порядке первого присваивания.
+ * Имена, которые нельзя связать со слотом (например, имена классов, объявленных внутри метода),
+ * по-прежнему ищутся в именованных переменных Closure.
+ * Инструкции return self.<тот же метод>(...) заменяются узлами TailCall, для аргументов
+ * которых в конце кадра отводится ещё n слотов. Новые узлы создаются в текущей арене,
+ * поэтому функцию вызывают внутри ArenaScope тела метода
+ */
+void ResolveSlots(runtime::Method& method);
+
+}  // namespace ast
@@ -1,77 +1,331 @@
 #include "runtime.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <functional>
+#include <unordered_set>
 
 #include <iostream>
 
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#endif
+
 using namespace std;
 
 namespace runtime {
 
 namespace {
-    const string EQUAL_METHOD = "__eq__"s;
-    const string LESS_METHOD = "__lt__"s;
-    const string TO_STRING_METHOD = "__str__"s;
+    const Symbol EQUAL_METHOD{"__eq__"};
+    const Symbol LESS_METHOD{"__lt__"};
+    const Symbol TO_STRING_METHOD{"__str__"};
+    const Symbol SELF{"self"};
 }  // namespace
 
-ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-    : data_(std::move(data)) {
+ObjectHolder::ObjectHolder(const ObjectHolder& other) noexcept
+    : payload_(other.payload_)
+    , tag_(other.tag_) {
+    if(tag_ == Tag::HEAP) {
+        payload_.object->AddRef();
+    }
 }
 
-void ObjectHolder::AssertIsValid() const {
+ObjectHolder& ObjectHolder::operator=(const ObjectHolder& other) noexcept {
+    if(this != &other) {
+        *this = ObjectHolder(other);
+    }
+    return *this;
+}
+
+ObjectHolder::ObjectHolder(ObjectHolder&& other) noexcept
+    : payload_(other.payload_)
+    , tag_(std::exchange(other.tag_, Tag::EMPTY)) {
+}
 
-    if (data_ == nullptr) {
-        assert(false);
+ObjectHolder& ObjectHolder::operator=(ObjectHolder&& other) noexcept {
+    if(this != &other) {
+        Reset();
+        payload_ = other.payload_;
+        tag_ = std::exchange(other.tag_, Tag::EMPTY);
     }
+    return *this;
+}
+
+ObjectHolder::~ObjectHolder() {
+    Reset();
+}
+
+void ObjectHolder::Reset() noexcept {
+    if(tag_ == Tag::HEAP && payload_.object->Release()) {
+        delete payload_.object;
+    }
+    tag_ = Tag::EMPTY;
+}
+
+void ObjectHolder::Adopt(Object* object) noexcept {
+    object->AddRef();
+    payload_.object = object;
+    tag_ = Tag::HEAP;
+}
 
-    assert(data_ != nullptr);
+void ObjectHolder::Box() {
+    if(tag_ == Tag::NUMBER) {
+        Adopt(new Number(payload_.number));
+    } else if(tag_ == Tag::BOOL) {
+        Adopt(new Bool(payload_.flag));
+    }
 }
 
-ObjectHolder ObjectHolder::Share(Object& object) {
-    // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-    return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
+void ObjectHolder::AssertIsValid() const {
+    assert(tag_ != Tag::NUMBER && tag_ != Tag::BOOL);
+    assert(GetObject() != nullptr);
 }
 
 ObjectHolder ObjectHolder::None() {
     return ObjectHolder();
 }
 
+ObjectHolder ObjectHolder::Unbound() {
+    ObjectHolder holder;
+    holder.tag_ = Tag::UNBOUND;
+    return holder;
+}
+
+Object& ObjectHolder::operator*() {
+    Box();
+    return *std::as_const(*this);
+}
+
 Object& ObjectHolder::operator*() const {
     AssertIsValid();
-    return *Get();
+    return *GetObject();
+}
+
+Object* ObjectHolder::operator->() {
+    Box();
+    return std::as_const(*this).operator->();
 }
 
 Object* ObjectHolder::operator->() const {
     AssertIsValid();
-    return Get();
+    return GetObject();
 }
 
-Object* ObjectHolder::Get() const {
-    return data_.get();
+const Shape* Shape::Empty() {
+    // Формы не разрушаются: на них ссылаются кэши доступа к полям
+    static const Shape* empty = new Shape();
+    return empty;
 }
 
-ObjectHolder::operator bool() const {
-    return Get() != nullptr;
+const Shape* Shape::Extend(Symbol name) const {
+    assert(shared_ && Find(name) == NOT_FOUND);
+    auto& next = transitions_[name];
+    if(!next) {
+        next.reset(new Shape(*this));
+        next->Append(name);
+    }
+    return next.get();
 }
 
-bool IsTrue(const ObjectHolder& object) {
-    if(!object) {
-        return false;
+void Shape::Append(Symbol name) {
+    names_.push_back(name);
+    if(!index_.empty()) {
+        index_.emplace(name, names_.size() - 1);
+    } else if(names_.size() > LINEAR_SEARCH_LIMIT) {
+        for(size_t i = 0; i < names_.size(); ++i) {
+            index_.emplace(names_[i], i);
+        }
     }
-    
-    if(String *str = object.TryAs<String>()) {
-        return str->GetValue().size() != 0;
+}
+
+Closure::Closure(std::initializer_list<value_type> variables) {
+    for(const auto& variable : variables) {
+        insert(variable);
     }
-    
-    if(Number *num = object.TryAs<Number>()) {
-        return num->GetValue() != 0;
+}
+
+Closure::Closure(ObjectHolder* frame, size_t frame_size)
+    : frame_(frame)
+    , frame_size_(frame_size) {
+}
+
+Closure::Closure(const Closure& other)
+    : shape_(other.shape_)
+    , values_(other.values_)
+    , frame_(other.frame_)
+    , frame_size_(other.frame_size_) {
+    if(other.own_shape_) {
+        own_shape_.reset(new Shape(*other.own_shape_));
+        shape_ = own_shape_.get();
     }
-    
-    if(Bool *b = object.TryAs<Bool>()) {
-        return b->GetValue();
+}
+
+Closure::Closure(Closure&& other) noexcept
+    : shape_(std::exchange(other.shape_, Shape::Empty()))
+    , values_(std::move(other.values_))
+    , own_shape_(std::move(other.own_shape_))
+    , frame_(std::exchange(other.frame_, nullptr))
+    , frame_size_(std::exchange(other.frame_size_, 0)) {
+    other.values_.clear();
+}
+
+Closure& Closure::operator=(const Closure& other) {
+    if(this != &other) {
+        Closure copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+Closure& Closure::operator=(Closure&& other) noexcept {
+    if(this != &other) {
+        shape_ = std::exchange(other.shape_, Shape::Empty());
+        values_ = std::move(other.values_);
+        own_shape_ = std::move(other.own_shape_);
+        frame_ = std::exchange(other.frame_, nullptr);
+        frame_size_ = std::exchange(other.frame_size_, 0);
+        other.values_.clear();
+    }
+    return *this;
+}
+
+size_t Closure::Add(Symbol name) {
+    if(own_shape_) {
+        own_shape_->Append(name);
+    } else if(shape_->Size() < Shape::MAX_SHARED_SIZE) {
+        shape_ = shape_->Extend(name);
+    } else {
+        // Слишком много имён для разделяемой формы: дальше набор меняет собственную форму
+        own_shape_.reset(new Shape(*shape_));
+        own_shape_->shared_ = false;
+        own_shape_->Append(name);
+        shape_ = own_shape_.get();
+    }
+    if(values_.empty()) {
+        values_.reserve(4);
+    }
+    values_.emplace_back();
+    return values_.size() - 1;
+}
+
+const ObjectHolder* Closure::FindSlow(Symbol name, FieldCache& cache) const {
+    const size_t index = shape_->Find(name);
+    if(index == Shape::NOT_FOUND) {
+        return nullptr;
+    }
+    if(shape_->IsShared()) {
+        cache = {shape_, nullptr, index};
+    }
+    return &values_[index];
+}
+
+ObjectHolder& Closure::EmplaceSlow(Symbol name, FieldCache& cache) {
+    const Shape* before = shape_;
+    size_t index = shape_->Find(name);
+    if(index != Shape::NOT_FOUND) {
+        if(before->IsShared()) {
+            cache = {before, nullptr, index};
+        }
+        return values_[index];
+    }
+    index = Add(name);
+    if(before->IsShared() && shape_->IsShared()) {
+        cache = {before, shape_, index};
+    }
+    return values_[index];
+}
+
+ObjectHolder& Closure::operator[](Symbol name) {
+    const size_t index = shape_->Find(name);
+    return values_[index != Shape::NOT_FOUND ? index : Add(name)];
+}
+
+ObjectHolder& Closure::at(Symbol name) {
+    const size_t index = shape_->Find(name);
+    if(index == Shape::NOT_FOUND) {
+        throw std::out_of_range("Unknown variable "s + name.Str());
+    }
+    return values_[index];
+}
+
+const ObjectHolder& Closure::at(Symbol name) const {
+    return const_cast<Closure&>(*this).at(name);
+}
+
+Closure::iterator Closure::find(Symbol name) {
+    const size_t index = shape_->Find(name);
+    return {this, index != Shape::NOT_FOUND ? index : values_.size()};
+}
+
+Closure::const_iterator Closure::find(Symbol name) const {
+    return const_cast<Closure&>(*this).find(name);
+}
+
+size_t Closure::count(Symbol name) const {
+    return shape_->Find(name) != Shape::NOT_FOUND ? 1 : 0;
+}
+
+std::pair<Closure::iterator, bool> Closure::insert(value_type variable) {
+    const size_t index = shape_->Find(variable.first);
+    if(index != Shape::NOT_FOUND) {
+        return {iterator{this, index}, false};
+    }
+    const size_t added = Add(variable.first);
+    values_[added] = std::move(variable.second);
+    return {iterator{this, added}, true};
+}
+
+Closure::iterator Closure::begin() {
+    return {this, 0};
+}
+
+Closure::iterator Closure::end() {
+    return {this, values_.size()};
+}
+
+Closure::const_iterator Closure::begin() const {
+    return {this, 0};
+}
+
+Closure::const_iterator Closure::end() const {
+    return {this, values_.size()};
+}
+
+size_t Closure::size() const {
+    return values_.size();
+}
+
+bool Closure::empty() const {
+    return values_.empty();
+}
+
+void Closure::clear() {
+    shape_ = Shape::Empty();
+    own_shape_.reset();
+    values_.clear();
+    frame_ = nullptr;
+    frame_size_ = 0;
+}
+
+bool IsTrue(const ObjectHolder& object) {
+    if(const int* number = object.TryAsValue<Number>()) {
+        return *number != 0;
+    }
+    if(const bool* flag = object.TryAsValue<Bool>()) {
+        return *flag;
+    }
+    if(const String* str = object.TryAs<String>()) {
+        return str->GetValue().size() != 0;
     }
     return false;
 }
@@ -89,7 +343,7 @@ void ClassInstance::Print(std::ostream& os, Context& context) {
     os << this;
 }
 
-bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
+bool ClassInstance::HasMethod(Symbol method, size_t argument_count) const {
     const Method* pmethod = cls_.GetMethod(method);
     if(pmethod == nullptr) {
         return false;
@@ -108,48 +362,390 @@ const Closure& ClassInstance::Fields() const {
     return fields_;
 }
 
-ClassInstance::ClassInstance(const Class& cls): cls_{cls} {
+const Class& ClassInstance::GetClass() const {
+    return cls_;
+}
+
+ClassInstance::ClassInstance(const Class& cls)
+: Object(KIND)
+, cls_{cls} {
     
 }
 
-ObjectHolder ClassInstance::Call(const std::string& method,
+ClassInstance::~ClassInstance() {
+    if(link_.tracked) {
+        CycleCollector::Get().Untrack(*this);
+    }
+}
+
+void TrackInstance(ClassInstance& instance) {
+    CycleCollector::Get().Track(instance);
+}
+
+CycleCollector& CycleCollector::Get() {
+    // Сборщик не разрушается, чтобы экземпляры в статических объектах могли сняться с учёта
+    static CycleCollector* collector = new CycleCollector();
+    return *collector;
+}
+
+CallStack& CallStack::Get() {
+    // Стек не разрушается по той же причине, что и сборщик: слоты могут держать экземпляры
+    static CallStack* stack = new CallStack();
+    return *stack;
+}
+
+namespace {
+
+// Запас стека процесса, который остаётся коду между вызовами методов и раскрутке исключения
+constexpr uintptr_t NATIVE_STACK_RESERVE = 256 * 1024;
+
+// Наименьший адрес стека текущего потока, до которого можно начинать вызов метода.
+// 0, если границы стека на этой платформе неизвестны
+uintptr_t GetNativeStackLimit() {
+    uintptr_t low = 0;
+    uintptr_t size = 0;
+#if defined(_WIN32)
+    ULONG_PTR stack_low = 0;
+    ULONG_PTR stack_high = 0;
+    GetCurrentThreadStackLimits(&stack_low, &stack_high);
+    low = stack_low;
+    size = stack_high - stack_low;
+#elif defined(__APPLE__)
+    // pthread_get_stackaddr_np возвращает верхнюю границу стека
+    size = pthread_get_stacksize_np(pthread_self());
+    low = reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np(pthread_self())) - size;
+#elif defined(__linux__)
+    pthread_attr_t attr;
+    if(pthread_getattr_np(pthread_self(), &attr) == 0) {
+        void* address = nullptr;
+        size_t stack_size = 0;
+        if(pthread_attr_getstack(&attr, &address, &stack_size) == 0) {
+            low = reinterpret_cast<uintptr_t>(address);
+            size = stack_size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+#endif
+    if(size == 0) {
+        return 0;
+    }
+    // Маленькому стеку потока оставляется четверть, а не весь запас
+    return low + std::min(NATIVE_STACK_RESERVE, size / 4);
+}
+
+// Адрес текущего кадра стека процесса. Адрес локальной переменной не подходит:
+// под AddressSanitizer она может лежать в куче
+uintptr_t GetNativeStackPointer() {
+#if defined(__GNUC__) || defined(__clang__)
+    return reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+#else
+    volatile char marker = 0;
+    return reinterpret_cast<uintptr_t>(&marker);
+#endif
+}
+
+}  // namespace
+
+CallStack::CallStack() {
+    blocks_.push_back({std::make_unique<ObjectHolder[]>(BLOCK_SIZE), BLOCK_SIZE});
+    frames_.reserve(DEFAULT_MAX_DEPTH);
+}
+
+ObjectHolder* CallStack::Push(size_t size) {
+    if(frames_.size() >= max_depth_) {
+        throw StackOverflowError("Maximum recursion depth "s + std::to_string(max_depth_) + " exceeded"s);
+    }
+    // Стек растёт вниз. Граница своя у каждого потока, поэтому вычисляется в нём самом
+    thread_local const uintptr_t native_limit = GetNativeStackLimit();
+    if(GetNativeStackPointer() < native_limit) {
+        throw StackOverflowError("Maximum recursion depth exceeded: native stack exhausted at depth "s
+                                 + std::to_string(frames_.size()));
+    }
+    frames_.push_back(top_);
+    if(top_.slot + size > blocks_[top_.block].size) {
+        // Кадр не помещается в остаток блока и целиком занимает начало следующего.
+        // Блоки за вершиной свободны, поэтому слишком маленький блок можно заменить
+        const size_t next = top_.block + 1;
+        if(next == blocks_.size() || blocks_[next].size < size) {
+            blocks_.resize(next);
+            const size_t block_size = std::max(BLOCK_SIZE, size);
+            blocks_.push_back({std::make_unique<ObjectHolder[]>(block_size), block_size});
+        }
+        top_ = {next, 0};
+    }
+    ObjectHolder* slots = blocks_[top_.block].slots.get() + top_.slot;
+    top_.slot += size;
+    return slots;
+}
+
+void CallStack::Pop() {
+    assert(!frames_.empty());
+    const Top previous = frames_.back();
+    frames_.pop_back();
+    const size_t first = previous.block == top_.block ? previous.slot : 0;
+    ObjectHolder* slots = blocks_[top_.block].slots.get();
+    for(size_t i = first; i < top_.slot; ++i) {
+        slots[i] = ObjectHolder();
+    }
+    top_ = previous;
+}
+
+size_t CallStack::GetDepth() const {
+    return frames_.size();
+}
+
+void CallStack::SetMaxDepth(size_t depth) {
+    max_depth_ = depth;
+}
+
+size_t CallStack::GetMaxDepth() const {
+    return max_depth_;
+}
+
+void CycleCollector::Track(ClassInstance& instance) {
+    auto& link = instance.link_;
+    assert(!link.tracked);
+    link.tracked = true;
+    link.prev = nullptr;
+    link.next = head_;
+    if(head_) {
+        head_->link_.prev = &instance;
+    }
+    head_ = &instance;
+    ++tracked_count_;
+
+    if(threshold_ != 0 && ++allocations_ >= threshold_ && !collecting_) {
+        Collect();
+    }
+}
+
+void CycleCollector::Untrack(ClassInstance& instance) {
+    auto& link = instance.link_;
+    assert(link.tracked);
+    if(link.prev) {
+        link.prev->link_.next = link.next;
+    } else {
+        head_ = link.next;
+    }
+    if(link.next) {
+        link.next->link_.prev = link.prev;
+    }
+    link = {};
+    --tracked_count_;
+}
+
+CycleCollector::Stats CycleCollector::Collect() {
+    Stats stats;
+    if(collecting_) {
+        return stats;
+    }
+    collecting_ = true;
+    allocations_ = 0;
+
+    // Ссылка из поля на отслеживаемый экземпляр. Невладеющие ссылки не увеличивают
+    // счётчик, поэтому не учитываются
+    auto tracked_referent = [](const ObjectHolder& holder) -> ClassInstance* {
+        if(holder.tag_ != ObjectHolder::Tag::HEAP) {
+            return nullptr;
+        }
+        auto* instance = holder.TryAs<ClassInstance>();
+        return instance && instance->link_.tracked ? instance : nullptr;
+    };
+
+    // Количество ссылок на экземпляр, которые не объясняются полями отслеживаемых экземпляров
+    std::unordered_map<const ClassInstance*, int64_t> external_refs;
+    external_refs.reserve(tracked_count_);
+    for(ClassInstance* instance = head_; instance; instance = instance->link_.next) {
+        external_refs[instance] = instance->ref_count_;
+    }
+    for(ClassInstance* instance = head_; instance; instance = instance->link_.next) {
+        for(const auto& [name, value] : instance->fields_) {
+            if(ClassInstance* referent = tracked_referent(value)) {
+                --external_refs[referent];
+            }
+        }
+    }
+
+    // Помечаем всё, что достижимо из экземпляров со ссылками извне
+    std::vector<const ClassInstance*> stack;
+    for(const auto& [instance, refs] : external_refs) {
+        if(refs > 0) {
+            stack.push_back(instance);
+        }
+    }
+    std::unordered_set<const ClassInstance*> reachable(stack.begin(), stack.end());
+    while(!stack.empty()) {
+        const ClassInstance* instance = stack.back();
+        stack.pop_back();
+        for(const auto& [name, value] : instance->fields_) {
+            ClassInstance* referent = tracked_referent(value);
+            if(referent && reachable.insert(referent).second) {
+                stack.push_back(referent);
+            }
+        }
+    }
+
+    // Удерживаем недостижимые экземпляры, пока очищаем их поля, чтобы они
+    // не освобождались посреди обхода
+    std::vector<ObjectPtr> garbage;
+    for(ClassInstance* instance = head_; instance; instance = instance->link_.next) {
+        if(reachable.count(instance) == 0) {
+            garbage.emplace_back(instance);
+            stats.bytes += sizeof(ClassInstance);
+            for(const auto& [name, value] : instance->fields_) {
+                stats.bytes += sizeof(Closure::value_type) + name.capacity();
+            }
+        }
+    }
+    stats.objects = garbage.size();
+    for(const ObjectPtr& ptr : garbage) {
+        static_cast<ClassInstance*>(ptr.get())->fields_.clear();
+    }
+    garbage.clear();
+
+    total_.objects += stats.objects;
+    total_.bytes += stats.bytes;
+    collecting_ = false;
+    return stats;
+}
+
+void CycleCollector::SetThreshold(size_t threshold) {
+    threshold_ = threshold;
+}
+
+size_t CycleCollector::GetThreshold() const {
+    return threshold_;
+}
+
+size_t CycleCollector::GetTrackedCount() const {
+    return tracked_count_;
+}
+
+CycleCollector::Stats CycleCollector::GetTotal() const {
+    return total_;
+}
+
+ObjectHolder ClassInstance::Call(Symbol method,
                                  const std::vector<ObjectHolder>& actual_args,
                                  Context& context) {
-    if(!HasMethod(method, actual_args.size())) {
-        throw std::runtime_error("Method: "s + method + " does not exist"s);
-    }
     const Method* pmethod = cls_.GetMethod(method);
+    if(pmethod == nullptr || pmethod->formal_params.size() != actual_args.size()) {
+        throw std::runtime_error("Method: "s + method.Str() + " does not exist"s);
+    }
+    return Call(*pmethod, actual_args, context);
+}
+
+ObjectHolder ClassInstance::Call(const Method& method,
+                                 const std::vector<ObjectHolder>& actual_args,
+                                 Context& context) {
+    assert(method.formal_params.size() == actual_args.size());
+    const CallStack::Frame frame(method.frame_size);
+    if(method.frame_size != 0) {
+        std::copy(actual_args.begin(), actual_args.end(), frame.Slots());
+        return CallInFrame(method, frame.Slots(), context);
+    }
     Closure filds;
     for(size_t i = 0; i < actual_args.size(); ++i) {
-        assert(actual_args[i].Get());
-        filds[pmethod->formal_params[i]] = actual_args[i];
+        assert(actual_args[i]);
+        filds[method.formal_params[i]] = actual_args[i];
+    }
+    filds[SELF] = ObjectHolder::Share(*this);
+    return method.body->Execute(filds, context);
+}
+
+ObjectHolder ClassInstance::CallInFrame(const Method& method, ObjectHolder* frame, Context& context) {
+    assert(method.frame_size != 0);
+    Closure slots(frame, method.frame_size);
+    slots.Slot(method.formal_params.size()) = ObjectHolder::Share(*this);
+    for(size_t i = method.formal_params.size() + 1; i < method.frame_size; ++i) {
+        slots.Slot(i) = ObjectHolder::Unbound();
     }
-    filds["self"] = ObjectHolder::Share(*this);
-    return pmethod->body->Execute(filds, context);
+    return method.body->Execute(slots, context);
 }
 
 Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
-: name_{std::move(name)}
+: Object(KIND)
+, name_{std::move(name)}
+, methods_{std::move(methods)}
 , parent_{parent} {
-    for(Method& method : methods) {
-        methods_[method.name] = std::move(method);
+    const size_t parent_count = parent_ ? parent_->method_count_ : 0;
+    if(parent_count + methods_.size() == 0) {
+        return;
     }
-}
+    size_t capacity = 1;
+    while(capacity < 2 * (parent_count + methods_.size())) {
+        capacity *= 2;
+    }
+    vtable_.resize(capacity);
 
-const Method* Class::GetMethod(const std::string& name) const {
-    if(methods_.count(name) == 0) {
-        if(parent_) {
-            return parent_->GetMethod(name);
+    if(parent_) {
+        for(const MethodEntry& entry : parent_->vtable_) {
+            if(entry.id != NO_METHOD_ID) {
+                AddToTable(entry.id, entry.method);
+            }
         }
-        return nullptr;
     }
-    return &methods_.at(name);
+    // Методы класса переопределяют унаследованные. Из одноимённых методов класса
+    // действует последний
+    for(const Method& method : methods_) {
+        AddToTable(InternMethodName(method.name), &method);
+    }
+}
+
+void Class::AddToTable(MethodId id, const Method* method) {
+    const size_t mask = vtable_.size() - 1;
+    size_t i = id & mask;
+    while(vtable_[i].id != NO_METHOD_ID && vtable_[i].id != id) {
+        i = (i + 1) & mask;
+    }
+    if(vtable_[i].id == NO_METHOD_ID) {
+        ++method_count_;
+    }
+    vtable_[i] = {id, method};
+}
+
+const Method* Class::GetMethod(Symbol name) const {
+    return GetMethod(FindMethodName(name));
+}
+
+namespace {
+
+std::unordered_map<Symbol, MethodId>& GetMethodIds() {
+    // Таблица не разрушается: классы в статических объектах могут обращаться к ней до конца работы
+    static auto* ids = new std::unordered_map<Symbol, MethodId>();
+    return *ids;
+}
+
+}  // namespace
+
+MethodId InternMethodName(Symbol name) {
+    auto& ids = GetMethodIds();
+    return ids.emplace(name, static_cast<MethodId>(ids.size())).first->second;
+}
+
+MethodId FindMethodName(Symbol name) {
+    const auto& ids = GetMethodIds();
+    const auto it = ids.find(name);
+    return it == ids.end() ? NO_METHOD_ID : it->second;
+}
+
+std::uint64_t Class::Id::Next() {
+    static std::atomic<std::uint64_t> next_id{0};
+    return ++next_id;
 }
 
 const std::string& Class::GetName() const {
     return name_;
 }
 
+const std::vector<Method>& Class::GetMethods() const {
+    return methods_;
+}
+
+const Class* Class::GetParent() const {
+    return parent_;
+}
+
 void Class::Print(ostream& os, Context& /*context*/) {
     os << "Class " << GetName();
 }
@@ -158,33 +754,46 @@ void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
     os << (GetValue() ? "True"sv : "False"sv);
 }
 
+namespace {
+
+// Сравнивает строки, логические значения и числа одного вида.
+// Для остальных пар объектов возвращает nullopt
 template <typename CompareFunc>
-bool Compare(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context, const std::string method_name, CompareFunc comparator) {
+optional<bool> ComparePrimitives(const ObjectHolder& lhs, const ObjectHolder& rhs, CompareFunc comparator) {
+    if(const int* lnumber = lhs.TryAsValue<Number>()) {
+        if(const int* rnumber = rhs.TryAsValue<Number>()) {
+            return comparator(*lnumber, *rnumber);
+        }
+    } else if(const bool* lflag = lhs.TryAsValue<Bool>()) {
+        if(const bool* rflag = rhs.TryAsValue<Bool>()) {
+            return comparator(*lflag, *rflag);
+        }
+    } else if(const String* lstring = lhs.TryAs<String>()) {
+        if(const String* rstring = rhs.TryAs<String>()) {
+            return comparator(lstring->GetValue(), rstring->GetValue());
+        }
+    }
+    return nullopt;
+}
 
-    #define COMPARE_VALUE_OBJ(TYPE) \
-    if(TYPE* lstr = lhs.TryAs<TYPE>()) {\
-        if(TYPE* rstr = rhs.TryAs<TYPE>()) {\
-            return comparator(lstr->GetValue(), rstr->GetValue());\
-        }\
+template <typename CompareFunc>
+bool Compare(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context, Symbol method_name, CompareFunc comparator) {
+    if (auto result = ComparePrimitives(lhs, rhs, comparator)) {
+        return *result;
     }
-    COMPARE_VALUE_OBJ(String)
-    COMPARE_VALUE_OBJ(Bool)
-    COMPARE_VALUE_OBJ(Number)
-    #undef COMPARE_VALUE_OBJ
 
     if (ClassInstance* lclass_instance = lhs.TryAs<ClassInstance>()) {
         assert(rhs);
-        Bool* b = lclass_instance->Call(method_name,
-            { ObjectHolder::Share(*rhs.Get()) },
-            context).TryAs<Bool>();
-        if (b) {
-            return b->GetValue();
+        ObjectHolder result = lclass_instance->Call(method_name, { rhs }, context);
+        if (const bool* b = result.TryAsValue<Bool>()) {
+            return *b;
         }
     }
-
     throw std::runtime_error("Invalid compare call"s);
 }
 
+}  // namespace
+
 bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
     
     if(!lhs && !rhs) {
@@ -202,7 +811,11 @@ bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context
     return !Equal(lhs, rhs, context);
 }
 
+// Значения встроенных типов сравниваются один раз, объекты классов - методами __lt__ и __eq__
 bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    if (auto result = ComparePrimitives(lhs, rhs, std::greater<>{})) {
+        return *result;
+    }
     if(Less(lhs, rhs, context)) {
         return false;
     }
@@ -211,6 +824,9 @@ bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context)
 }
 
 bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    if (auto result = ComparePrimitives(lhs, rhs, std::less_equal<>{})) {
+        return *result;
+    }
     return Less(lhs, rhs, context) || Equal(lhs, rhs, context);
 }
 
@@ -1,9 +1,19 @@
 #pragma once
 
+#include "symbol.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace runtime {
@@ -18,80 +28,612 @@ protected:
     ~Context() = default;
 };
 
+// Вид объекта. Позволяет проверять тип встроенных объектов без RTTI
+enum class ObjectKind : std::uint8_t {
+    USER,
+    NUMBER,
+    STRING,
+    BOOL,
+    CLASS,
+    CLASS_INSTANCE,
+};
+
+// Счётчик ссылок объекта. Интерпретатор однопоточный, поэтому по умолчанию счётчик
+// не атомарный. При встраивании в многопоточную программу соберите с MYTHON_ATOMIC_REFCOUNT
+#ifdef MYTHON_ATOMIC_REFCOUNT
+using RefCount = std::atomic<std::uint32_t>;
+#else
+using RefCount = std::uint32_t;
+#endif
+
 // Базовый класс для всех объектов языка Mython
 class Object {
 public:
     virtual ~Object() = default;
     // выводит в os своё представление в виде строки
     virtual void Print(std::ostream& os, Context& context) = 0;
+
+    [[nodiscard]] ObjectKind GetKind() const {
+        return kind_;
+    }
+
+protected:
+    explicit Object(ObjectKind kind = ObjectKind::USER)
+        : kind_(kind) {
+    }
+
+    // Копия объекта - новый объект, на который пока никто не ссылается
+    Object(const Object& other)
+        : kind_(other.kind_) {
+    }
+
+    Object& operator=(const Object& /*other*/) {
+        return *this;
+    }
+
+private:
+    friend class ObjectPtr;
+    friend class ObjectHolder;
+    friend class CycleCollector;
+
+    void AddRef() const noexcept {
+#ifdef MYTHON_ATOMIC_REFCOUNT
+        ref_count_.fetch_add(1, std::memory_order_relaxed);
+#else
+        ++ref_count_;
+#endif
+    }
+
+    // Возвращает true, если ссылок на объект не осталось
+    bool Release() const noexcept {
+#ifdef MYTHON_ATOMIC_REFCOUNT
+        return ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+#else
+        return --ref_count_ == 0;
+#endif
+    }
+
+    mutable RefCount ref_count_{0};
+    ObjectKind kind_;
+};
+
+// Владеющий указатель на объект в куче. Использует счётчик ссылок внутри Object,
+// поэтому занимает одно машинное слово и не требует отдельного блока управления
+class ObjectPtr {
+public:
+    ObjectPtr() = default;
+
+    explicit ObjectPtr(Object* object) noexcept
+        : object_(object) {
+        if (object_ != nullptr) {
+            object_->AddRef();
+        }
+    }
+
+    ObjectPtr(const ObjectPtr& other) noexcept
+        : ObjectPtr(other.object_) {
+    }
+
+    ObjectPtr(ObjectPtr&& other) noexcept
+        : object_(std::exchange(other.object_, nullptr)) {
+    }
+
+    ObjectPtr& operator=(const ObjectPtr& other) noexcept {
+        ObjectPtr(other).Swap(*this);
+        return *this;
+    }
+
+    ObjectPtr& operator=(ObjectPtr&& other) noexcept {
+        ObjectPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ~ObjectPtr() {
+        if (object_ != nullptr && object_->Release()) {
+            delete object_;
+        }
+    }
+
+    [[nodiscard]] Object* get() const noexcept {
+        return object_;
+    }
+
+    void Swap(ObjectPtr& other) noexcept {
+        std::swap(object_, other.object_);
+    }
+
+private:
+    Object* object_ = nullptr;
+};
+
+// Объект-значение, хранящий значение типа T
+template <typename T>
+class ValueObject : public Object {
+public:
+    // Вид объекта, по которому ObjectHolder::TryAs узнаёт ValueObject<T>
+    static constexpr ObjectKind KIND = std::is_same_v<T, int>           ? ObjectKind::NUMBER
+                                       : std::is_same_v<T, std::string> ? ObjectKind::STRING
+                                       : std::is_same_v<T, bool>        ? ObjectKind::BOOL
+                                                                        : ObjectKind::USER;
+    using ValueType = T;
+
+    ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        : Object(KIND)
+        , value_(v) {
+    }
+
+    void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+        os << value_;
+    }
+
+    [[nodiscard]] const T& GetValue() const {
+        return value_;
+    }
+
+private:
+    T value_;
+};
+
+// Строковое значение
+using String = ValueObject<std::string>;
+// Числовое значение
+using Number = ValueObject<int>;
+
+// Логическое значение
+class Bool : public ValueObject<bool> {
+public:
+    using ValueObject<bool>::ValueObject;
+
+    void Print(std::ostream& os, Context& context) override;
 };
 
-// Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+class Class;
+class ClassInstance;
+
+// Ставит экземпляр класса, размещённый в куче, на учёт сборщика циклических ссылок
+void TrackInstance(ClassInstance& instance);
+
+// Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+// Числа и логические значения хранятся непосредственно внутри ObjectHolder,
+// поэтому их создание и копирование не обращаются к куче. ObjectHolder занимает
+// два машинных слова: указатель или встроенное значение и тег вида значения
 class ObjectHolder {
 public:
     // Создаёт пустое значение
     ObjectHolder() = default;
 
+    ObjectHolder(const ObjectHolder& other) noexcept;
+    ObjectHolder& operator=(const ObjectHolder& other) noexcept;
+    // После перемещения other становится пустым
+    ObjectHolder(ObjectHolder&& other) noexcept;
+    ObjectHolder& operator=(ObjectHolder&& other) noexcept;
+    ~ObjectHolder();
+
     // Возвращает ObjectHolder, владеющий объектом типа T
     // Тип T - конкретный класс-наследник Object.
-    // object копируется или перемещается в кучу
+    // Number и Bool размещаются внутри ObjectHolder, остальные объекты копируются
+    // или перемещаются в кучу
     template <typename T>
     [[nodiscard]] static ObjectHolder Own(T&& object) {
-        return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+        using Type = std::decay_t<T>;
+        ObjectHolder holder;
+        if constexpr (std::is_same_v<Type, Number>) {
+            holder.tag_ = Tag::NUMBER;
+            holder.payload_.number = object.GetValue();
+        } else if constexpr (std::is_same_v<Type, Bool>) {
+            holder.tag_ = Tag::BOOL;
+            holder.payload_.flag = object.GetValue();
+        } else {
+            auto* ptr = new Type(std::forward<T>(object));
+            holder.Adopt(ptr);
+            if constexpr (std::is_base_of_v<ClassInstance, Type>) {
+                TrackInstance(*ptr);
+            }
+        }
+        return holder;
     }
 
-    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
-    [[nodiscard]] static ObjectHolder Share(Object& object);
+    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки).
+    // Хранит только указатель и не выделяет память
+    [[nodiscard]] static ObjectHolder Share(Object& object) {
+        ObjectHolder holder;
+        holder.tag_ = Tag::BORROWED;
+        holder.payload_.object = &object;
+        return holder;
+    }
     // Создаёт пустой ObjectHolder, соответствующий значению None
     [[nodiscard]] static ObjectHolder None();
+    // Создаёт значение слота локальной переменной, которой ещё ничего не присвоено.
+    // Как и None, не содержит объекта, но чтение такой переменной - ошибка
+    [[nodiscard]] static ObjectHolder Unbound();
+
+    [[nodiscard]] bool IsUnbound() const {
+        return tag_ == Tag::UNBOUND;
+    }
+
+    // Переносит встроенное число или логическое значение в кучу, после чего ObjectHolder
+    // хранит объект. Для остальных значений ничего не делает. Указатели, полученные
+    // от TryAsValue, после этого недействительны
+    void Box();
 
     // Возвращает ссылку на Object внутри ObjectHolder.
-    // ObjectHolder должен быть непустым
+    // ObjectHolder должен быть непустым. Неконстантные версии переносят встроенное
+    // значение в кучу (см. Box). Константные версии ObjectHolder не меняют,
+    // поэтому не применимы к встроенным значениям
+    Object& operator*();
     Object& operator*() const;
 
+    Object* operator->();
     Object* operator->() const;
 
-    [[nodiscard]] Object* Get() const;
+    // Возвращает указатель на хранимый объект либо nullptr, если ObjectHolder пуст.
+    // Встроенное значение переносится в кучу (см. Box)
+    [[nodiscard]] Object* Get() {
+        Box();
+        return GetObject();
+    }
+
+    // Возвращает указатель на хранимый объект либо nullptr, если ObjectHolder пуст.
+    // Встроенное значение объектом не является: прочитать его можно через TryAsValue,
+    // а получить объект - через неконстантный Get или копию ObjectHolder
+    [[nodiscard]] Object* Get() const {
+        assert(tag_ != Tag::NUMBER && tag_ != Tag::BOOL);
+        return GetObject();
+    }
 
     // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
-    // объект данного типа
+    // объект данного типа. Встроенные типы распознаются по ObjectKind, их наследники и остальные
+    // типы - через dynamic_cast. Если встроенное значение может оказаться T, оно переносится
+    // в кучу (см. Box), поэтому там, где нужно только значение числа или логического значения,
+    // дешевле TryAsValue
+    template <typename T>
+    [[nodiscard]] T* TryAs() {
+        if constexpr (MayBeImmediate<T>()) {
+            // Встроенное значение не переносится в кучу, если оно заведомо не T
+            if ((tag_ == Tag::NUMBER && !std::is_base_of_v<T, Number>) || (tag_ == Tag::BOOL && !std::is_base_of_v<T, Bool>)) {
+                return nullptr;
+            }
+            Box();
+        }
+        return CastObject<T>(GetObject());
+    }
+
+    // Константная версия не меняет ObjectHolder и применима только к типам,
+    // которыми встроенное значение быть не может. Для чисел и логических значений есть TryAsValue
     template <typename T>
     [[nodiscard]] T* TryAs() const {
-        return dynamic_cast<T*>(this->Get());
+        static_assert(!MayBeImmediate<T>(), "use TryAsValue or a non-const ObjectHolder");
+        return CastObject<T>(GetObject());
+    }
+
+    // Возвращает указатель на значение числа (T - Number) или логического значения (T - Bool)
+    // либо nullptr, если внутри ObjectHolder хранится что-то другое. Встроенное значение
+    // не переносится в кучу. Указатель действителен, пока ObjectHolder не изменён
+    template <typename T>
+    [[nodiscard]] const typename T::ValueType* TryAsValue() const {
+        static_assert(std::is_same_v<T, Number> || std::is_same_v<T, Bool>);
+        if constexpr (std::is_same_v<T, Number>) {
+            if (tag_ == Tag::NUMBER) {
+                return &payload_.number;
+            }
+        } else {
+            if (tag_ == Tag::BOOL) {
+                return &payload_.flag;
+            }
+        }
+        if (tag_ != Tag::HEAP && tag_ != Tag::BORROWED) {
+            return nullptr;
+        }
+        // ValueObject<bool> распознаётся по виду, в отличие от своего наследника Bool
+        const auto* object = CastObject<ValueObject<typename T::ValueType>>(GetObject());
+        return object != nullptr ? &object->GetValue() : nullptr;
     }
 
     // Возвращает true, если ObjectHolder не пуст
-    explicit operator bool() const;
+    explicit operator bool() const {
+        return tag_ != Tag::EMPTY && tag_ != Tag::UNBOUND;
+    }
 
 private:
-    explicit ObjectHolder(std::shared_ptr<Object> data);
+    friend class CycleCollector;
+
+    enum class Tag : std::uint8_t { EMPTY, HEAP, BORROWED, NUMBER, BOOL, UNBOUND };
+
+    // Значение, на которое указывает тег: HEAP и BORROWED хранят указатель
+    // (HEAP владеет ссылкой на объект), NUMBER и BOOL - само значение
+    union Payload {
+        Object* object;
+        int number;
+        bool flag;
+    };
+
+    // Тип T однозначно определяется своим ObjectKind. Наследники этих типов (в том числе Bool)
+    // получают тот же вид, что и базовый класс, поэтому для них вид не доказывает тип
+    template <typename T>
+    static constexpr bool HasKind() {
+        return std::is_same_v<T, Number> || std::is_same_v<T, String> || std::is_same_v<T, ValueObject<bool>>
+               || std::is_same_v<T, Class> || std::is_same_v<T, ClassInstance>;
+    }
+
+    // Встроенным значением может оказаться объект типа T: это Number, Bool и их базовые классы
+    template <typename T>
+    static constexpr bool MayBeImmediate() {
+        return std::is_base_of_v<T, Number> || std::is_base_of_v<T, Bool>;
+    }
+
+    template <typename T>
+    static T* CastObject(Object* object) {
+        if constexpr (HasKind<T>()) {
+            if (object != nullptr && object->GetKind() == T::KIND) {
+                return static_cast<T*>(object);
+            }
+            return nullptr;
+        } else {
+            return dynamic_cast<T*>(object);
+        }
+    }
+
+    // Указатель на объект, хранящийся по указателю, либо nullptr
+    [[nodiscard]] Object* GetObject() const {
+        return tag_ == Tag::HEAP || tag_ == Tag::BORROWED ? payload_.object : nullptr;
+    }
+
+    // Становится владельцем объекта object, только что созданного в куче
+    void Adopt(Object* object) noexcept;
+    void Reset() noexcept;
     void AssertIsValid() const;
 
-    std::shared_ptr<Object> data_;
+    Payload payload_{nullptr};
+    Tag tag_ = Tag::EMPTY;
 };
 
-// Объект-значение, хранящий значение типа T
-template <typename T>
-class ValueObject : public Object {
+/*
+ * Форма (скрытый класс) набора именованных переменных: имена в порядке добавления.
+ * Значения хранятся отдельно, в массиве Closure, в том же порядке.
+ *
+ * Формы образуют дерево переходов: добавление имени к форме всегда даёт одну и ту же
+ * дочернюю форму, поэтому объекты, поля которых заполняются одинаково (обычно в __init__),
+ * разделяют одну форму. Такие формы живут до конца работы программы, и точки доступа
+ * к полям могут запоминать форму и номер поля в ней (см. FieldCache).
+ * Набор, в котором больше MAX_SHARED_SIZE имён, получает собственную изменяемую форму.
+ *
+ * Формы не потокобезопасны
+ */
+class Shape {
 public:
-    ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-        : value_(v) {
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+    // Наибольшее количество имён в разделяемой форме
+    static constexpr size_t MAX_SHARED_SIZE = 32;
+
+    // Форма без имён, с которой начинается любой набор переменных
+    static const Shape* Empty();
+
+    // Возвращает номер имени name либо NOT_FOUND
+    [[nodiscard]] size_t Find(Symbol name) const {
+        if (index_.empty()) {
+            for (size_t i = 0; i < names_.size(); ++i) {
+                if (names_[i] == name) {
+                    return i;
+                }
+            }
+            return NOT_FOUND;
+        }
+        const auto it = index_.find(name);
+        return it == index_.end() ? NOT_FOUND : it->second;
     }
 
-    void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
-        os << value_;
+    [[nodiscard]] const std::string& GetName(size_t index) const {
+        return names_[index].Str();
     }
 
-    [[nodiscard]] const T& GetValue() const {
-        return value_;
+    [[nodiscard]] size_t Size() const {
+        return names_.size();
+    }
+
+    // Разделяемую форму можно запоминать в кэшах: она не меняется и не разрушается
+    [[nodiscard]] bool IsShared() const {
+        return shared_;
     }
 
+    // Возвращает разделяемую форму с добавленным в конец именем name
+    [[nodiscard]] const Shape* Extend(Symbol name) const;
+
 private:
-    T value_;
+    friend class Closure;
+
+    // Количество имён, начиная с которого поиск идёт по хеш-таблице
+    static constexpr size_t LINEAR_SEARCH_LIMIT = 8;
+
+    Shape() = default;
+    // Копирует имена, но не переходы
+    Shape(const Shape& other)
+        : names_(other.names_)
+        , index_(other.index_)
+        , shared_(other.shared_) {
+    }
+    void Append(Symbol name);
+
+    std::vector<Symbol> names_;
+    std::unordered_map<Symbol, size_t> index_;
+    // Переходы к дочерним разделяемым формам
+    mutable std::unordered_map<Symbol, std::unique_ptr<Shape>> transitions_;
+    bool shared_ = true;
+};
+
+// Кэш точки доступа к переменной или полю по имени. Запоминает разделяемую форму,
+// при которой имя было найдено, и номер имени в ней. Для записи нового имени
+// запоминает также форму после добавления
+struct FieldCache {
+    const Shape* shape = nullptr;
+    const Shape* next = nullptr;
+    size_t index = 0;
 };
 
-// Таблица символов, связывающая имя объекта с его значением
-using Closure = std::unordered_map<std::string, ObjectHolder>;
+// Таблица символов, связывающая имя объекта с его значением.
+// Именованные переменные хранятся в массиве, порядок которого описывает форма (Shape).
+// Помимо именованных переменных может ссылаться на кадр слотов: локальные переменные
+// и параметры метода, которым при разборе назначены номера, читаются из кадра по индексу.
+// Кадр не принадлежит Closure (обычно его выделяет CallStack), копия ссылается на те же слоты
+class Closure {
+    template <bool IsConst>
+    class Iterator;
+
+public:
+    using value_type = std::pair<const std::string, ObjectHolder>;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    Closure() = default;
+    Closure(std::initializer_list<value_type> variables);
+    // Создаёт замыкание с кадром из frame_size слотов, начинающимся с frame
+    Closure(ObjectHolder* frame, size_t frame_size);
+
+    Closure(const Closure& other);
+    Closure(Closure&& other) noexcept;
+    Closure& operator=(const Closure& other);
+    Closure& operator=(Closure&& other) noexcept;
+    ~Closure() = default;
+
+    ObjectHolder& operator[](Symbol name);
+    // Выбрасывают std::out_of_range, если переменной name нет
+    [[nodiscard]] ObjectHolder& at(Symbol name);
+    [[nodiscard]] const ObjectHolder& at(Symbol name) const;
+    [[nodiscard]] iterator find(Symbol name);
+    [[nodiscard]] const_iterator find(Symbol name) const;
+    [[nodiscard]] size_t count(Symbol name) const;
+    std::pair<iterator, bool> insert(value_type variable);
+
+    // Переменные перебираются в порядке добавления
+    [[nodiscard]] iterator begin();
+    [[nodiscard]] iterator end();
+    [[nodiscard]] const_iterator begin() const;
+    [[nodiscard]] const_iterator end() const;
+
+    // Количество именованных переменных
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+    void clear();
+
+    // Возвращает переменную name либо nullptr. cache ускоряет повторные обращения
+    // из той же точки программы
+    [[nodiscard]] const ObjectHolder* Find(Symbol name, FieldCache& cache) const {
+        if (shape_ == cache.shape) {
+            return &values_[cache.index];
+        }
+        return FindSlow(name, cache);
+    }
+
+    [[nodiscard]] ObjectHolder* Find(Symbol name, FieldCache& cache) {
+        return const_cast<ObjectHolder*>(std::as_const(*this).Find(name, cache));
+    }
+
+    // Возвращает переменную name, добавляя её при необходимости. cache ускоряет
+    // повторные обращения из той же точки программы
+    ObjectHolder& Emplace(Symbol name, FieldCache& cache) {
+        if (shape_ == cache.shape) {
+            if (cache.next == nullptr) {
+                return values_[cache.index];
+            }
+            shape_ = cache.next;
+            return values_.emplace_back();
+        }
+        return EmplaceSlow(name, cache);
+    }
+
+    [[nodiscard]] const Shape& GetShape() const {
+        return *shape_;
+    }
+
+    // Возвращает количество слотов кадра
+    [[nodiscard]] size_t FrameSize() const {
+        return frame_size_;
+    }
+
+    // Возвращает слот кадра с номером index. index должен быть меньше FrameSize()
+    [[nodiscard]] ObjectHolder& Slot(size_t index) {
+        return frame_[index];
+    }
+
+    [[nodiscard]] const ObjectHolder& Slot(size_t index) const {
+        return frame_[index];
+    }
+
+private:
+    template <bool IsConst>
+    class Iterator {
+    public:
+        using Holder = std::conditional_t<IsConst, const ObjectHolder, ObjectHolder>;
+        using Owner = std::conditional_t<IsConst, const Closure, Closure>;
+
+        // Пара "имя - значение", ссылающаяся на переменную внутри Closure
+        struct reference {
+            const std::string& first;
+            Holder& second;
+        };
+        struct pointer {
+            reference ref;
+            const reference* operator->() const {
+                return &ref;
+            }
+        };
+        using value_type = Closure::value_type;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        Iterator(Owner* closure, size_t index)
+            : closure_(closure)
+            , index_(index) {
+        }
+
+        // Неконстантный итератор приводится к константному
+        template <bool OtherConst, typename = std::enable_if_t<IsConst && !OtherConst>>
+        Iterator(const Iterator<OtherConst>& other)  // NOLINT(google-explicit-constructor)
+            : closure_(other.closure_)
+            , index_(other.index_) {
+        }
+
+        reference operator*() const {
+            return {closure_->shape_->GetName(index_), closure_->values_[index_]};
+        }
+        pointer operator->() const {
+            return {**this};
+        }
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator result = *this;
+            ++index_;
+            return result;
+        }
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_ && closure_ == other.closure_;
+        }
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class Closure;
+        friend class Iterator<!IsConst>;
+
+        Owner* closure_;
+        size_t index_;
+    };
+
+    const ObjectHolder* FindSlow(Symbol name, FieldCache& cache) const;
+    ObjectHolder& EmplaceSlow(Symbol name, FieldCache& cache);
+    // Добавляет переменную name, которой ещё нет, и возвращает её номер
+    size_t Add(Symbol name);
+
+    const Shape* shape_ = Shape::Empty();
+    std::vector<ObjectHolder> values_;
+    // Собственная форма набора, в котором больше Shape::MAX_SHARED_SIZE имён
+    std::unique_ptr<Shape> own_shape_;
+    ObjectHolder* frame_ = nullptr;
+    size_t frame_size_ = 0;
+};
 
 // Проверяет, содержится ли в object значение, приводимое к True
 // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
@@ -106,53 +648,117 @@ public:
     virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
 };
 
-// Строковое значение
-using String = ValueObject<std::string>;
-// Числовое значение
-using Number = ValueObject<int>;
-
-// Логическое значение
-class Bool : public ValueObject<bool> {
-public:
-    using ValueObject<bool>::ValueObject;
-
-    void Print(std::ostream& os, Context& context) override;
-};
-
 // Метод класса
 struct Method {
     // Имя метода
-    std::string name;
+    Symbol name;
     // Имена формальных параметров метода
-    std::vector<std::string> formal_params;
+    std::vector<Symbol> formal_params;
     // Тело метода
     std::unique_ptr<Executable> body;
+    // Размер кадра слотов тела метода. Если он не равен нулю, параметры занимают
+    // слоты [0, n), self - слот n, а сам метод вызывается с кадром вместо именованных переменных
+    size_t frame_size = 0;
 };
 
+// Номер имени метода. Одноимённые методы всех классов получают один и тот же номер,
+// номера выдаются подряд, начиная с нуля
+using MethodId = std::uint32_t;
+inline constexpr MethodId NO_METHOD_ID = static_cast<MethodId>(-1);
+
+// Возвращает номер имени метода name, регистрируя имя при первом обращении.
+// Таблица имён не потокобезопасна
+MethodId InternMethodName(Symbol name);
+// Возвращает номер имени метода name либо NO_METHOD_ID, если такое имя не регистрировалось
+MethodId FindMethodName(Symbol name);
+
 // Класс
 class Class : public Object {
 public:
+    static constexpr ObjectKind KIND = ObjectKind::CLASS;
+
     // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
     // Если parent равен nullptr, то создаётся базовый класс
     explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
 
     // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-    [[nodiscard]] const Method* GetMethod(const std::string& name) const;
+    [[nodiscard]] const Method* GetMethod(Symbol name) const;
+
+    // Возвращает метод с номером имени id, объявленный в классе или унаследованный,
+    // либо nullptr. Не зависит от глубины иерархии классов
+    [[nodiscard]] const Method* GetMethod(MethodId id) const {
+        if (vtable_.empty()) {
+            return nullptr;
+        }
+        // Поиск останавливается на нужном номере либо на пустом элементе, у которого
+        // номер NO_METHOD_ID и метод nullptr
+        const size_t mask = vtable_.size() - 1;
+        for (size_t i = id & mask;; i = (i + 1) & mask) {
+            const MethodEntry& entry = vtable_[i];
+            if (entry.id == id || entry.id == NO_METHOD_ID) {
+                return entry.method;
+            }
+        }
+    }
 
     // Возвращает имя класса
     [[nodiscard]] const std::string& GetName() const;
 
+    // Возвращает собственные методы класса, без унаследованных
+    [[nodiscard]] const std::vector<Method>& GetMethods() const;
+
+    // Возвращает родительский класс либо nullptr, если класс базовый
+    [[nodiscard]] const Class* GetParent() const;
+
+    // Возвращает номер, уникальный среди всех когда-либо созданных классов.
+    // В отличие от адреса, номер не переходит к новому классу после разрушения старого
+    [[nodiscard]] std::uint64_t GetId() const {
+        return id_.value;
+    }
+
     // Выводит в os строку "Class <имя класса>", например "Class cat"
     void Print(std::ostream& os, Context& context) override;
 private:
+    // Копия или перемещённый класс получают новый номер
+    struct Id {
+        std::uint64_t value = Next();
+
+        Id() = default;
+        Id(const Id& /*other*/) {
+        }
+        Id& operator=(const Id& /*other*/) {
+            value = Next();
+            return *this;
+        }
+
+        static std::uint64_t Next();
+    };
+
+    Id id_;
     std::string name_;
-    std::unordered_map<std::string, Method> methods_;
+    // Собственные методы класса
+    std::vector<Method> methods_;
     const Class* parent_;
+    struct MethodEntry {
+        MethodId id = NO_METHOD_ID;
+        const Method* method = nullptr;
+    };
+
+    // Добавляет в таблицу метод с номером имени id либо заменяет метод с тем же номером
+    void AddToTable(MethodId id, const Method* method);
+
+    // Таблица всех методов класса, включая унаследованные: хеш-таблица с открытой адресацией
+    // по номеру имени. Размер таблицы - степень двойки, не меньше удвоенного числа методов,
+    // поэтому память растёт с числом методов класса, а не с числом имён в программе
+    std::vector<MethodEntry> vtable_;
+    size_t method_count_ = 0;
 };
 
 // Экземпляр класса
 class ClassInstance : public Object {
 public:
+    static constexpr ObjectKind KIND = ObjectKind::CLASS_INSTANCE;
+
     explicit ClassInstance(const Class& cls);
 
     /*
@@ -167,19 +773,197 @@ public:
      * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
      * runtime_error
      */
-    ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
+    ObjectHolder Call(Symbol method, const std::vector<ObjectHolder>& actual_args,
                       Context& context);
 
+    /*
+     * Вызывает у объекта уже найденный метод method его класса.
+     * Количество actual_args должно совпадать с количеством параметров метода
+     */
+    ObjectHolder Call(const Method& method, const std::vector<ObjectHolder>& actual_args,
+                      Context& context);
+
+    /*
+     * Вызывает метод method, у которого есть кадр слотов (method.frame_size != 0),
+     * в кадре frame, уже выделенном из CallStack. Первые слоты кадра должны содержать
+     * аргументы вызова. Слот self метод заполняет сам, а слоты локальных переменных
+     * делает неприсвоенными (ObjectHolder::Unbound)
+     */
+    ObjectHolder CallInFrame(const Method& method, ObjectHolder* frame, Context& context);
+
     // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
-    [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
+    [[nodiscard]] bool HasMethod(Symbol method, size_t argument_count) const;
 
     // Возвращает ссылку на Closure, содержащий поля объекта
     [[nodiscard]] Closure& Fields();
     // Возвращает константную ссылку на Closure, содержащую поля объекта
     [[nodiscard]] const Closure& Fields() const;
+
+    // Возвращает класс, экземпляром которого является объект
+    [[nodiscard]] const Class& GetClass() const;
+
+    ~ClassInstance() override;
 private:
+    friend class CycleCollector;
+
+    // Звено списка экземпляров, которые отслеживает CycleCollector.
+    // Копия экземпляра на учёт не ставится
+    struct TrackingLink {
+        ClassInstance* prev = nullptr;
+        ClassInstance* next = nullptr;
+        bool tracked = false;
+
+        TrackingLink() = default;
+        TrackingLink(const TrackingLink& /*other*/) {
+        }
+        TrackingLink& operator=(const TrackingLink& /*other*/) {
+            return *this;
+        }
+    };
+
     const Class& cls_;
     Closure fields_;
+    TrackingLink link_;
+};
+
+/*
+ * Сборщик циклических ссылок между экземплярами классов.
+ *
+ * Счётчик ссылок не освобождает экземпляры, которые ссылаются друг на друга через поля.
+ * Сборщик отслеживает экземпляры, созданные через ObjectHolder::Own, и находит среди них
+ * недостижимые извне: из счётчика ссылок каждого экземпляра вычитаются ссылки из полей
+ * других отслеживаемых экземпляров. Экземпляры с ненулевым остатком и всё достижимое
+ * из них живы. У остальных очищаются поля, после чего их освобождает счётчик ссылок.
+ *
+ * Сборщик не потокобезопасен
+ */
+class CycleCollector {
+public:
+    // Сборка запускается после каждых DEFAULT_THRESHOLD новых экземпляров
+    static constexpr size_t DEFAULT_THRESHOLD = 10000;
+
+    // Результат сборки
+    struct Stats {
+        // Количество освобождённых экземпляров
+        size_t objects = 0;
+        // Приблизительный объём освобождённой памяти: экземпляры и их поля
+        size_t bytes = 0;
+    };
+
+    static CycleCollector& Get();
+
+    // Находит и освобождает недостижимые экземпляры
+    Stats Collect();
+
+    // Задаёт, после скольких новых экземпляров сборка запускается автоматически.
+    // 0 отключает автоматическую сборку
+    void SetThreshold(size_t threshold);
+    [[nodiscard]] size_t GetThreshold() const;
+
+    // Количество отслеживаемых экземпляров
+    [[nodiscard]] size_t GetTrackedCount() const;
+    // Суммарный результат всех сборок
+    [[nodiscard]] Stats GetTotal() const;
+
+    void Track(ClassInstance& instance);
+    void Untrack(ClassInstance& instance);
+
+private:
+    CycleCollector() = default;
+
+    ClassInstance* head_ = nullptr;
+    size_t tracked_count_ = 0;
+    size_t threshold_ = DEFAULT_THRESHOLD;
+    size_t allocations_ = 0;
+    bool collecting_ = false;
+    Stats total_;
+};
+
+// Выбрасывается, когда глубина вызовов методов превышает CallStack::GetMaxDepth()
+class StackOverflowError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/*
+ * Стек кадров вызовов методов. Слоты кадров (параметры, self и локальные переменные)
+ * выделяются и освобождаются в порядке LIFO из заранее выделенных блоков, поэтому вызов
+ * метода не обращается к malloc. Когда блок заканчивается, стек берёт следующий блок,
+ * а не перевыделяет текущий, так что адреса слотов живых кадров не меняются.
+ * Освобождённые блоки остаются за стеком и используются повторно.
+ *
+ * Количество кадров ограничено: вместо переполнения стека процесса глубокая рекурсия
+ * завершается исключением StackOverflowError. Оно же выбрасывается, если стек процесса
+ * почти исчерпан, какой бы большой ни была GetMaxDepth(): при обходе дерева каждый
+ * вызов метода - ещё и рекурсия C++, и глубину, которую выдержит стек процесса,
+ * заранее не вычислить.
+ *
+ * Стек не потокобезопасен
+ */
+class CallStack {
+public:
+    // При обходе дерева каждый вызов метода - ещё и цепочка вложенных вызовов функций C++,
+    // около килобайта стека процесса. Глубина по умолчанию оставляет запас стеку размером 8 МБ.
+    // Виртуальная машина вызывает скомпилированные методы без рекурсии C++, и ей можно
+    // разрешить глубину в миллионы вызовов. Обход дерева при такой глубине остановится
+    // раньше, когда закончится стек процесса
+    static constexpr size_t DEFAULT_MAX_DEPTH = 3000;
+    // Количество слотов в блоке, выделяемом заранее
+    static constexpr size_t BLOCK_SIZE = 16 * 1024;
+
+    // Кадр, который занимает слоты стека на время своего существования
+    class Frame {
+    public:
+        explicit Frame(size_t size)
+            : slots_(Get().Push(size)) {
+        }
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+        ~Frame() {
+            Get().Pop();
+        }
+
+        [[nodiscard]] ObjectHolder* Slots() const {
+            return slots_;
+        }
+
+    private:
+        ObjectHolder* slots_;
+    };
+
+    static CallStack& Get();
+
+    // Выделяет кадр из size пустых слотов и возвращает первый из них.
+    // Выбрасывает StackOverflowError, если стек уже содержит GetMaxDepth() кадров
+    // или у стека процесса не осталось запаса
+    ObjectHolder* Push(size_t size);
+    // Очищает слоты последнего выделенного кадра и освобождает его
+    void Pop();
+
+    // Количество выделенных кадров
+    [[nodiscard]] size_t GetDepth() const;
+
+    void SetMaxDepth(size_t depth);
+    [[nodiscard]] size_t GetMaxDepth() const;
+
+private:
+    struct Block {
+        std::unique_ptr<ObjectHolder[]> slots;
+        size_t size = 0;
+    };
+    // Вершина стека: номер блока и первый свободный слот в нём
+    struct Top {
+        size_t block = 0;
+        size_t slot = 0;
+    };
+
+    CallStack();
+
+    std::vector<Block> blocks_;
+    // Вершины стека перед выделением каждого из кадров
+    std::vector<Top> frames_;
+    Top top_;
+    size_t max_depth_ = DEFAULT_MAX_DEPTH;
 };
 
 /*
@@ -203,9 +987,9 @@ bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
 bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
 // Возвращает значение, противоположное Equal(lhs, rhs, context)
 bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение lhs>rhs, используя функции Equal и Less
+// Возвращает значение lhs>rhs. Объекты классов сравниваются функциями Equal и Less
 bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение lhs<=rhs, используя функции Equal и Less
+// Возвращает значение lhs<=rhs. Объекты классов сравниваются функциями Equal и Less
 bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
 // Возвращает значение, противоположное Less(lhs, rhs, context)
 bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
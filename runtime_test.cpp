@@ -19,13 +19,15 @@ public:
     }
 
     Logger(const Logger& rhs)
-        : id_(rhs.id_)  //
+        : Object(rhs)
+        , id_(rhs.id_)  //
     {
         ++instance_count;
     }
 
     Logger(Logger&& rhs) noexcept
-        : id_(rhs.id_)  //
+        : Object(rhs)
+        , id_(rhs.id_)  //
     {
         ++instance_count;
     }
@@ -248,6 +250,100 @@ void TestNullptr() {
     ASSERT(!oh.Get());
 }
 
+void TestImmediates() {
+    auto num = ObjectHolder::Own(Number{42});
+    auto copy = num;
+    ASSERT(num.TryAs<Number>() != nullptr && num.TryAs<Number>()->GetValue() == 42);
+    ASSERT(copy.TryAs<Number>() != nullptr && copy.TryAs<Number>()->GetValue() == 42);
+    ASSERT(num.Get() != copy.Get());
+    ASSERT(num.TryAs<Bool>() == nullptr);
+    ASSERT(num.TryAs<String>() == nullptr);
+
+    auto flag = ObjectHolder::Own(Bool{true});
+    ASSERT(flag.TryAs<Bool>() != nullptr && flag.TryAs<Bool>()->GetValue());
+    ASSERT(flag.TryAs<ValueObject<bool>>() != nullptr);
+    ASSERT(flag.TryAs<Number>() == nullptr);
+
+    ObjectHolder moved = std::move(num);
+    ASSERT(!num);  // NOLINT
+    ASSERT(moved.TryAs<Number>()->GetValue() == 42);
+
+    // TryAsValue читает встроенное значение на месте. Константные операции ObjectHolder
+    // не меняют, поэтому указатель на значение остаётся действительным
+    static_assert(sizeof(ObjectHolder) <= 16);
+    auto value = ObjectHolder::Own(Number{5});
+    const ObjectHolder& view = value;
+    const int* raw = view.TryAsValue<Number>();
+    ASSERT(raw != nullptr && *raw == 5);
+    ASSERT(view.TryAsValue<Bool>() == nullptr);
+    ASSERT(view.TryAs<String>() == nullptr && view.TryAs<ClassInstance>() == nullptr);
+    ASSERT(IsTrue(view) && view);
+    // Объект для константного ObjectHolder получают из копии
+    ObjectHolder boxed_copy = view;
+    DummyContext print_context;
+    boxed_copy->Print(print_context.output, print_context);
+    ASSERT_EQUAL(print_context.output.str(), "5"s);
+    ASSERT(view.TryAsValue<Number>() == raw && *raw == 5);
+    ASSERT(flag.TryAsValue<Bool>() != nullptr && *flag.TryAsValue<Bool>());
+    ASSERT(!ObjectHolder().TryAsValue<Number>());
+
+    // Объект для встроенного значения создаёт только неконстантный ObjectHolder
+    const Number* boxed = value.TryAs<Number>();
+    ASSERT(value.TryAsValue<Number>() == &boxed->GetValue());
+    ASSERT(value.Get() == boxed);
+    auto value_copy = value;
+    ASSERT(value_copy.Get() == boxed);
+    ASSERT(IsTrue(value) && !IsTrue(ObjectHolder::Own(Number{0})));
+
+    Number shared_num{7};
+    auto shared = ObjectHolder::Share(shared_num);
+    ASSERT(shared.TryAs<Number>() == &shared_num);
+
+    DummyContext context;
+    flag->Print(context.output, context);
+    moved->Print(context.output, context);
+    ASSERT_EQUAL(context.output.str(), "True42"s);
+}
+
+void TestBorrowed() {
+    String str{"borrowed"s};
+    auto borrowed = ObjectHolder::Share(str);
+    auto copy = borrowed;
+    ASSERT(borrowed.Get() == &str);
+    ASSERT(copy.TryAs<String>() == &str);
+    ASSERT(copy.TryAs<Number>() == nullptr);
+    ASSERT(IsTrue(copy));
+
+    ObjectHolder moved = std::move(borrowed);
+    ASSERT(!borrowed);  // NOLINT
+    ASSERT(moved.TryAs<String>() == &str);
+    ASSERT_EQUAL(str.GetValue(), "borrowed"s);
+}
+
+// Наследник встроенного типа получает вид базового класса, но TryAs не принимает за него
+// объект базового класса
+void TestTryAsSubclasses() {
+    class Tagged : public ClassInstance {
+    public:
+        using ClassInstance::ClassInstance;
+    };
+
+    Class cls{"Test"s, {}, nullptr};
+    ClassInstance plain{cls};
+    Tagged tagged{cls};
+    auto plain_holder = ObjectHolder::Share(plain);
+    auto tagged_holder = ObjectHolder::Share(tagged);
+    ASSERT(plain_holder.TryAs<ClassInstance>() == &plain);
+    ASSERT(plain_holder.TryAs<Tagged>() == nullptr);
+    ASSERT(tagged_holder.TryAs<ClassInstance>() == &tagged);
+    ASSERT(tagged_holder.TryAs<Tagged>() == &tagged);
+
+    ValueObject<bool> flag{true};
+    auto flag_holder = ObjectHolder::Share(flag);
+    ASSERT(flag_holder.TryAs<ValueObject<bool>>() == &flag);
+    ASSERT(flag_holder.TryAs<Bool>() == nullptr);
+}
+
 void TestIsTrue() {
     {
         ASSERT(!IsTrue(ObjectHolder::Own(Bool{false})));
@@ -504,6 +600,159 @@ void TestClass() {
     ASSERT_EQUAL(out.str(), "Class Test"s);
 }
 
+void TestMethodTable() {
+    auto returns = [](int value) {
+        return make_unique<TestMethodBody>([value](Closure&, Context&) {
+            return ObjectHolder::Own(Number{value});
+        });
+    };
+
+    // Цепочка наследования: класс i переопределяет "value" на чётных уровнях
+    // и добавляет собственный метод "level_i"
+    constexpr int DEPTH = 12;
+    vector<unique_ptr<Class>> chain;
+    for (int i = 0; i < DEPTH; ++i) {
+        vector<Method> methods;
+        if (i % 2 == 0) {
+            methods.push_back({"value"s, {}, returns(i)});
+        }
+        methods.push_back({"level_"s + to_string(i), {}, returns(i)});
+        chain.push_back(make_unique<Class>("C"s + to_string(i), move(methods),
+                                           chain.empty() ? nullptr : chain.back().get()));
+    }
+
+    DummyContext ctx;
+    Closure closure;
+    auto call = [&](const Class& cls, const string& name) {
+        return cls.GetMethod(name)->body->Execute(closure, ctx).TryAs<Number>()->GetValue();
+    };
+    for (int i = 0; i < DEPTH; ++i) {
+        ASSERT_EQUAL(call(*chain[i], "value"s), i - i % 2);
+        ASSERT_EQUAL(call(*chain[i], "level_0"s), 0);
+        ASSERT_EQUAL(call(*chain[i], "level_"s + to_string(i)), i);
+        ASSERT(chain[i]->GetMethod("level_"s + to_string(i + 1)) == nullptr);
+    }
+
+    // Одно и то же имя имеет один номер во всех классах
+    const MethodId value_id = FindMethodName("value"s);
+    ASSERT(value_id != NO_METHOD_ID);
+    ASSERT_EQUAL(InternMethodName("value"s), value_id);
+    ASSERT(chain.back()->GetMethod(value_id) == chain.back()->GetMethod("value"s));
+    ASSERT(chain.back()->GetMethod(value_id) == chain[DEPTH - 2]->GetMethod(value_id));
+
+    // Таблица каждого класса содержит только его методы, сколько бы имён ни было в программе
+    vector<unique_ptr<Class>> many;
+    for (int i = 0; i < 500; ++i) {
+        vector<Method> methods;
+        methods.push_back({"value"s, {}, returns(i)});
+        for (int j = 0; j < 5; ++j) {
+            methods.push_back({"many_"s + to_string(i) + "_"s + to_string(j), {}, returns(j)});
+        }
+        many.push_back(make_unique<Class>("M"s + to_string(i), move(methods), chain.back().get()));
+    }
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_EQUAL(call(*many[i], "value"s), i);
+        ASSERT_EQUAL(call(*many[i], "many_"s + to_string(i) + "_4"s), 4);
+        ASSERT_EQUAL(call(*many[i], "level_3"s), 3);
+        ASSERT(many[i]->GetMethod("many_"s + to_string((i + 1) % 500) + "_0"s) == nullptr);
+    }
+
+    ASSERT_EQUAL(FindMethodName("never_declared_method"s), NO_METHOD_ID);
+    ASSERT(chain.back()->GetMethod(NO_METHOD_ID) == nullptr);
+    ASSERT(chain.back()->GetMethod("never_declared_method"s) == nullptr);
+}
+
+void TestSymbols() {
+    const Symbol a{"field_name"};
+    const Symbol b{"field_"s + "name"s};
+    const size_t count = GetSymbolCount();
+
+    // Одинаковые имена дают один символ, повторное интернирование не расширяет таблицу
+    ASSERT(a == b);
+    ASSERT(&a.Str() == &b.Str());
+    ASSERT_EQUAL(std::hash<Symbol>{}(a), std::hash<Symbol>{}(b));
+    ASSERT(a == Symbol{"field_name"sv});
+    ASSERT_EQUAL(GetSymbolCount(), count);
+
+    ASSERT(a != Symbol{"other_name"});
+    ASSERT_EQUAL(GetSymbolCount(), count + 1);
+
+    ASSERT(Symbol{}.Empty());
+    ASSERT(Symbol{} == Symbol{""s});
+    ASSERT_EQUAL(a.Str(), "field_name"s);
+    const string& as_string = a;
+    ASSERT_EQUAL(as_string, "field_name"s);
+
+    ostringstream out;
+    out << a;
+    ASSERT_EQUAL(out.str(), "field_name"s);
+}
+
+void TestShapes() {
+    Class cls{"Point"s, {}, nullptr};
+    ClassInstance a{cls};
+    ClassInstance b{cls};
+    a.Fields()["x"s] = ObjectHolder::Own(Number{1});
+    a.Fields()["y"s] = ObjectHolder::Own(Number{2});
+    b.Fields()["x"s] = ObjectHolder::Own(Number{3});
+    ASSERT(&a.Fields().GetShape() != &b.Fields().GetShape());
+    b.Fields()["y"s] = ObjectHolder::Own(Number{4});
+
+    // Объекты, поля которых добавлены в одном порядке, разделяют форму
+    const Shape& shape = a.Fields().GetShape();
+    ASSERT(&shape == &b.Fields().GetShape());
+    ASSERT(shape.IsShared());
+    ASSERT_EQUAL(shape.Size(), 2U);
+    ASSERT_EQUAL(shape.Find("y"s), 1U);
+    ASSERT_EQUAL(shape.Find("z"s), Shape::NOT_FOUND);
+
+    // Переменные перебираются в порядке добавления
+    string items;
+    for (const auto& [name, value] : b.Fields()) {
+        items += name + '=' + to_string(value.TryAs<Number>()->GetValue()) + ' ';
+    }
+    ASSERT_EQUAL(items, "x=3 y=4 "s);
+
+    // Кэш точки доступа срабатывает на всех объектах той же формы
+    FieldCache cache;
+    ASSERT_EQUAL(a.Fields().Find("y"s, cache)->TryAs<Number>()->GetValue(), 2);
+    ASSERT(cache.shape == &shape);
+    ASSERT_EQUAL(b.Fields().Find("y"s, cache)->TryAs<Number>()->GetValue(), 4);
+    FieldCache missing;
+    ASSERT(a.Fields().Find("z"s, missing) == nullptr);
+
+    FieldCache store;
+    a.Fields().Emplace("z"s, store) = ObjectHolder::Own(Number{5});
+    ASSERT(store.shape == &shape && store.next == &a.Fields().GetShape());
+    b.Fields().Emplace("z"s, store) = ObjectHolder::Own(Number{6});
+    ASSERT(&a.Fields().GetShape() == &b.Fields().GetShape());
+    ASSERT_EQUAL(b.Fields().at("z"s).TryAs<Number>()->GetValue(), 6);
+    ASSERT_THROWS(static_cast<void>(b.Fields().at("w"s)), std::out_of_range);
+
+    // Набор с большим количеством имён получает собственную форму
+    Closure many;
+    const int count = static_cast<int>(Shape::MAX_SHARED_SIZE) * 2;
+    for (int i = 0; i < count; ++i) {
+        many["v"s + to_string(i)] = ObjectHolder::Own(Number{i});
+    }
+    ASSERT(!many.GetShape().IsShared());
+    FieldCache many_cache;
+    ASSERT_EQUAL(many.Find("v40"s, many_cache)->TryAs<Number>()->GetValue(), 40);
+    ASSERT(many_cache.shape == nullptr);
+
+    Closure copy = many;
+    copy["extra"s] = ObjectHolder::None();
+    ASSERT_EQUAL(copy.size(), many.size() + 1);
+    ASSERT_EQUAL(many.count("extra"s), 0U);
+    ASSERT_EQUAL(copy.at("v0"s).TryAs<Number>()->GetValue(), 0);
+
+    Closure moved = std::move(copy);
+    ASSERT_EQUAL(moved.size(), many.size() + 1);
+    ASSERT(copy.empty());
+    copy["x"s] = ObjectHolder::None();
+    ASSERT_EQUAL(copy.size(), 1U);
+}
+
 void TestClassInstance() {
     vector<Method> methods;
 
@@ -529,6 +778,88 @@ void TestClassInstance() {
     ASSERT_THROWS(instance.Call("missing_method"s, {}, ctx), runtime_error);
 }
 
+void TestCycleCollector() {
+    CycleCollector& collector = CycleCollector::Get();
+    const size_t threshold = collector.GetThreshold();
+    collector.SetThreshold(0);
+    collector.Collect();
+    const size_t tracked = collector.GetTrackedCount();
+
+    Class cls{"Node"s, {}, nullptr};
+    ObjectHolder alive = ObjectHolder::Own(ClassInstance{cls});
+    {
+        // Цикл parent <-> child, недостижимый после выхода из блока
+        ObjectHolder parent = ObjectHolder::Own(ClassInstance{cls});
+        ObjectHolder child = ObjectHolder::Own(ClassInstance{cls});
+        parent.TryAs<ClassInstance>()->Fields()["child"s] = child;
+        child.TryAs<ClassInstance>()->Fields()["parent"s] = parent;
+
+        // Цикл, на который ссылается alive
+        ObjectHolder first = ObjectHolder::Own(ClassInstance{cls});
+        ObjectHolder second = ObjectHolder::Own(ClassInstance{cls});
+        first.TryAs<ClassInstance>()->Fields()["next"s] = second;
+        second.TryAs<ClassInstance>()->Fields()["next"s] = first;
+        alive.TryAs<ClassInstance>()->Fields()["list"s] = first;
+
+        // Невладеющая ссылка не удерживает цикл, но и не считается ссылкой из поля
+        alive.TryAs<ClassInstance>()->Fields()["self"s] = ObjectHolder::Share(*alive);
+    }
+    ASSERT_EQUAL(collector.GetTrackedCount(), tracked + 5);
+
+    const CycleCollector::Stats stats = collector.Collect();
+    ASSERT_EQUAL(stats.objects, 2u);
+    ASSERT(stats.bytes >= 2 * sizeof(ClassInstance));
+    ASSERT_EQUAL(collector.GetTrackedCount(), tracked + 3);
+
+    const ObjectHolder& first = alive.TryAs<ClassInstance>()->Fields().at("list"s);
+    const ObjectHolder& second = first.TryAs<ClassInstance>()->Fields().at("next"s);
+    ASSERT(second.TryAs<ClassInstance>()->Fields().at("next"s).Get() == first.Get());
+
+    // Если забыть alive, освобождается и цикл, на который он ссылался
+    alive.TryAs<ClassInstance>()->Fields()["back"s] = first;
+    second.TryAs<ClassInstance>()->Fields()["owner"s] = alive;
+    alive = ObjectHolder::None();
+    ASSERT_EQUAL(collector.Collect().objects, 3u);
+    ASSERT_EQUAL(collector.GetTrackedCount(), tracked);
+
+    collector.SetThreshold(threshold);
+}
+
+void TestCallStack() {
+    CallStack& stack = CallStack::Get();
+    const size_t max_depth = stack.GetMaxDepth();
+    const size_t depth = stack.GetDepth();
+    stack.SetMaxDepth(depth + 3);
+
+    Logger::instance_count = 0;
+    {
+        const CallStack::Frame outer(2);
+        outer.Slots()[1] = ObjectHolder::Own(Logger{});
+        {
+            // Кадр больше блока не помещается в текущий блок и получает свой,
+            // а слоты внешнего кадра остаются на месте
+            const CallStack::Frame inner(CallStack::BLOCK_SIZE + 1);
+            inner.Slots()[CallStack::BLOCK_SIZE] = ObjectHolder::Own(Logger{});
+            ASSERT_EQUAL(Logger::instance_count, 2);
+
+            const CallStack::Frame empty(0);
+            ASSERT_EQUAL(stack.GetDepth(), depth + 3);
+            ASSERT_THROWS(CallStack::Frame(1), StackOverflowError);
+            ASSERT_EQUAL(stack.GetDepth(), depth + 3);
+        }
+        ASSERT_EQUAL(Logger::instance_count, 1);
+        ASSERT(outer.Slots()[1].TryAs<Logger>() != nullptr);
+
+        // Освобождённые слоты выдаются снова уже пустыми
+        const CallStack::Frame reused(CallStack::BLOCK_SIZE + 1);
+        ASSERT(!reused.Slots()[CallStack::BLOCK_SIZE]);
+    }
+    ASSERT_EQUAL(Logger::instance_count, 0);
+    ASSERT_EQUAL(stack.GetDepth(), depth);
+
+    stack.SetMaxDepth(max_depth);
+}
+
 }  // namespace
 
 void RunObjectsTests(TestRunner& tr) {
@@ -539,7 +870,12 @@ void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestIsTrue);
     RUN_TEST(tr, runtime::TestComparison);
     RUN_TEST(tr, runtime::TestClass);
+    RUN_TEST(tr, runtime::TestMethodTable);
     RUN_TEST(tr, runtime::TestClassInstance);
+    RUN_TEST(tr, runtime::TestShapes);
+    RUN_TEST(tr, runtime::TestSymbols);
+    RUN_TEST(tr, runtime::TestCycleCollector);
+    RUN_TEST(tr, runtime::TestCallStack);
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
@@ -547,6 +883,9 @@ void RunObjectHolderTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestOwning);
     RUN_TEST(tr, runtime::TestMove);
     RUN_TEST(tr, runtime::TestNullptr);
+    RUN_TEST(tr, runtime::TestImmediates);
+    RUN_TEST(tr, runtime::TestBorrowed);
+    RUN_TEST(tr, runtime::TestTryAsSubclasses);
 }
 
 }  // namespace runtime
\ No newline at end of file
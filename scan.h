@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MYTHON_SCAN_SSE2
+#endif
+
+// Поиск границ лексем, который проверяет сразу 16 (SSE2) или 32 (AVX2) байта.
+// Без SIMD-инструкций используется побайтовый поиск. Классы символов заданы
+// для ASCII и не зависят от локали: байты больше 127 не входят ни в один класс
+namespace parse::scan {
+
+[[nodiscard]] constexpr bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+[[nodiscard]] constexpr bool IsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Символ, который может входить в идентификатор или число
+[[nodiscard]] constexpr bool IsWordChar(char c) {
+    return IsAlpha(c) || IsDigit(c) || c == '_';
+}
+
+// Пробельный символ внутри строки программы
+[[nodiscard]] constexpr bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Побайтовые варианты поиска. Совпадают по результату с векторными
+[[nodiscard]] inline size_t SkipWordScalar(std::string_view text, size_t pos) {
+    while (pos < text.size() && IsWordChar(text[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+[[nodiscard]] inline size_t SkipSpacesScalar(std::string_view text, size_t pos) {
+    while (pos < text.size() && IsSpace(text[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+[[nodiscard]] inline size_t FindQuoteOrEscapeScalar(std::string_view text, size_t pos, char quote) {
+    while (pos < text.size() && text[pos] != quote && text[pos] != '\\') {
+        ++pos;
+    }
+    return pos;
+}
+
+namespace detail {
+
+#if defined(__AVX2__)
+using Vector = __m256i;
+constexpr size_t VECTOR_SIZE = 32;
+
+inline Vector Load(const char* data) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+}
+inline Vector Splat(char c) {
+    return _mm256_set1_epi8(c);
+}
+inline Vector Equal(Vector a, Vector b) {
+    return _mm256_cmpeq_epi8(a, b);
+}
+inline Vector Less(Vector a, Vector b) {
+    return _mm256_cmpgt_epi8(b, a);
+}
+inline Vector Add(Vector a, Vector b) {
+    return _mm256_add_epi8(a, b);
+}
+inline Vector Or(Vector a, Vector b) {
+    return _mm256_or_si256(a, b);
+}
+inline unsigned Mask(Vector v) {
+    return static_cast<unsigned>(_mm256_movemask_epi8(v));
+}
+#elif defined(MYTHON_SCAN_SSE2)
+using Vector = __m128i;
+constexpr size_t VECTOR_SIZE = 16;
+
+inline Vector Load(const char* data) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+inline Vector Splat(char c) {
+    return _mm_set1_epi8(c);
+}
+inline Vector Equal(Vector a, Vector b) {
+    return _mm_cmpeq_epi8(a, b);
+}
+inline Vector Less(Vector a, Vector b) {
+    return _mm_cmplt_epi8(a, b);
+}
+inline Vector Add(Vector a, Vector b) {
+    return _mm_add_epi8(a, b);
+}
+inline Vector Or(Vector a, Vector b) {
+    return _mm_or_si128(a, b);
+}
+inline unsigned Mask(Vector v) {
+    return static_cast<unsigned>(_mm_movemask_epi8(v));
+}
+#endif
+
+#if defined(__AVX2__) || defined(MYTHON_SCAN_SSE2)
+constexpr unsigned FULL_MASK = VECTOR_SIZE == 32 ? ~0U : (1U << VECTOR_SIZE) - 1;
+
+// Байты из диапазона [first, first + count): сдвиг переводит диапазон к началу
+// знакового диапазона, после чего хватает одного знакового сравнения
+inline Vector InRange(Vector v, char first, int count) {
+    const Vector shifted = Add(v, Splat(static_cast<char>(-128 - first)));
+    return Less(shifted, Splat(static_cast<char>(-128 + count)));
+}
+
+inline unsigned CountTrailingZeros(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Возвращает первую позицию, начиная с pos, для которой matches(блок) даёт бит 0.
+// Хвост короче вектора проверяет scalar: читать за концом текста нельзя
+template <typename Matches, typename Scalar>
+size_t SkipWhile(std::string_view text, size_t pos, Matches matches, Scalar scalar) {
+    while (pos + VECTOR_SIZE <= text.size()) {
+        const unsigned rest = ~Mask(matches(Load(text.data() + pos))) & FULL_MASK;
+        if (rest != 0) {
+            return pos + CountTrailingZeros(rest);
+        }
+        pos += VECTOR_SIZE;
+    }
+    return scalar(text, pos);
+}
+#endif
+
+}  // namespace detail
+
+// Возвращает позицию первого символа, начиная с pos, который не может входить в идентификатор
+[[nodiscard]] inline size_t SkipWord(std::string_view text, size_t pos) {
+#if defined(__AVX2__) || defined(MYTHON_SCAN_SSE2)
+    using namespace detail;
+    return SkipWhile(
+        text, pos,
+        [](Vector v) {
+            // Установка бита 0x20 переводит заглавные латинские буквы в строчные
+            const Vector alpha = InRange(Or(v, Splat(0x20)), 'a', 26);
+            return Or(Or(alpha, InRange(v, '0', 10)), Equal(v, Splat('_')));
+        },
+        SkipWordScalar);
+#else
+    return SkipWordScalar(text, pos);
+#endif
+}
+
+// Возвращает позицию первого непробельного символа, начиная с pos
+[[nodiscard]] inline size_t SkipSpaces(std::string_view text, size_t pos) {
+#if defined(__AVX2__) || defined(MYTHON_SCAN_SSE2)
+    using namespace detail;
+    return SkipWhile(
+        text, pos,
+        [](Vector v) {
+            return Or(Or(Equal(v, Splat(' ')), Equal(v, Splat('\t'))), Equal(v, Splat('\r')));
+        },
+        SkipSpacesScalar);
+#else
+    return SkipSpacesScalar(text, pos);
+#endif
+}
+
+// Возвращает позицию первой кавычки quote или обратной косой черты, начиная с pos
+[[nodiscard]] inline size_t FindQuoteOrEscape(std::string_view text, size_t pos, char quote) {
+#if defined(__AVX2__) || defined(MYTHON_SCAN_SSE2)
+    using namespace detail;
+    const Vector quotes = Splat(quote);
+    const Vector escapes = Splat('\\');
+    // Пропускаются байты, которые не являются ни кавычкой, ни обратной косой чертой
+    const size_t skipped = SkipWhile(
+        text, pos,
+        [&](Vector v) {
+            return Equal(Or(Equal(v, quotes), Equal(v, escapes)), Splat(0));
+        },
+        [quote](std::string_view tail, size_t from) {
+            return FindQuoteOrEscapeScalar(tail, from, quote);
+        });
+    return skipped;
+#else
+    return FindQuoteOrEscapeScalar(text, pos, quote);
+#endif
+}
+
+}  // namespace parse::scan
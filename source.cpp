@@ -0,0 +1,93 @@
+#include "source.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace parse {
+
+namespace {
+
+string ReadFile(const string& path) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    return {istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+}
+
+}  // namespace
+
+SourceBuffer SourceBuffer::FromFile(const string& path) {
+    SourceBuffer buffer;
+#if !defined(_WIN32)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    struct stat info{};
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            buffer.mapping_ = mapping;
+            buffer.mapping_size_ = static_cast<size_t>(info.st_size);
+        }
+    }
+    close(fd);
+    if (buffer.IsMapped()) {
+        madvise(buffer.mapping_, buffer.mapping_size_, MADV_SEQUENTIAL);
+        return buffer;
+    }
+#endif
+    // Пустой файл, канал или система без mmap: текст читается в строку
+    buffer.storage_ = ReadFile(path);
+    return buffer;
+}
+
+SourceBuffer SourceBuffer::FromString(string text) {
+    SourceBuffer buffer;
+    buffer.storage_ = std::move(text);
+    return buffer;
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept
+    : storage_(std::move(other.storage_))
+    , mapping_(std::exchange(other.mapping_, nullptr))
+    , mapping_size_(std::exchange(other.mapping_size_, 0)) {
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept {
+    if (this != &other) {
+        Unmap();
+        storage_ = std::move(other.storage_);
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        mapping_size_ = std::exchange(other.mapping_size_, 0);
+    }
+    return *this;
+}
+
+SourceBuffer::~SourceBuffer() {
+    Unmap();
+}
+
+void SourceBuffer::Unmap() noexcept {
+#if !defined(_WIN32)
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapping_size_);
+    }
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+}
+
+}  // namespace parse
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace parse {
+
+// Текст программы, непрерывно размещённый в памяти.
+// Файл по возможности отображается в память (mmap), а не читается в строку,
+// поэтому лексер может разбирать его без копирования
+class SourceBuffer {
+public:
+    // Открывает файл path. Выбрасывает std::runtime_error, если файл нельзя прочитать
+    static SourceBuffer FromFile(const std::string& path);
+    static SourceBuffer FromString(std::string text);
+
+    SourceBuffer(SourceBuffer&& other) noexcept;
+    SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer();
+
+    // Текст действителен, пока существует буфер
+    [[nodiscard]] std::string_view GetText() const {
+        if (mapping_ != nullptr) {
+            return {static_cast<const char*>(mapping_), mapping_size_};
+        }
+        return storage_;
+    }
+
+    // Возвращает true, если файл отображён в память
+    [[nodiscard]] bool IsMapped() const {
+        return mapping_ != nullptr;
+    }
+
+private:
+    SourceBuffer() = default;
+    void Unmap() noexcept;
+
+    // Текст, если он не отображён из файла
+    std::string storage_;
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+};
+
+}  // namespace parse
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <sstream>
 #include <cassert>
+#include <algorithm>
+#include <cstddef>
 
 using namespace std;
 
@@ -16,16 +18,29 @@ using runtime::Method;
     
 
 namespace {
-const string ADD_METHOD = "__add__"s;
-const string INIT_METHOD = "__init__"s;
-const string SUB_METHOD = "__sub__"s;
-const string MUL_METHOD = "__mul__"s;
-const string DIV_METHOD = "__truediv__"s;
+const runtime::Symbol ADD_METHOD{"__add__"};
+
+const runtime::Symbol INIT_METHOD{"__init__"};
+const runtime::Symbol SUB_METHOD{"__sub__"};
+const runtime::Symbol MUL_METHOD{"__mul__"};
+const runtime::Symbol DIV_METHOD{"__truediv__"};
 const string NONE = "None"s;
+
+int GetRangeArgument(const ObjectHolder& value) {
+    if(const int* num = value.TryAsValue<runtime::Number>()) {
+        return *num;
+    }
+    throw std::runtime_error("range() arguments must be numbers"s);
+}
 }  // namespace
 
 void PrintObjectHolder(const ObjectHolder& obj, Context& context) {
-    if (obj) {
+    // Встроенные значения печатаются без переноса в кучу
+    if (const int* number = obj.TryAsValue<runtime::Number>()) {
+        runtime::Number(*number).Print(context.GetOutputStream(), context);
+    } else if (const bool* flag = obj.TryAsValue<runtime::Bool>()) {
+        runtime::Bool(*flag).Print(context.GetOutputStream(), context);
+    } else if (obj) {
         obj.Get()->Print(context.GetOutputStream(), context);
     }
     else {
@@ -41,43 +56,83 @@ std::ostream& operator<<(std::ostream& os, const ObjectHolder& obj) {
 
 ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
     ObjectHolder ret = rv_->Execute(closure, context);
-    closure[var_] = ret;
+    if(slot_ < closure.FrameSize()) {
+        closure.Slot(slot_) = ret;
+    } else {
+        closure.Emplace(var_, cache_) = ret;
+    }
     return ret;
 }
 
-Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv)
+Assignment::Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv)
 : var_{std::move(var)}
 , rv_{std::move(rv)} {
 }
 
-VariableValue::VariableValue(const std::string& var_name)
-: dotted_ids_{var_name} {
-    assert(var_name.find('.') == var_name.npos);
+runtime::Symbol Assignment::GetVar() const {
+    return var_;
+}
+
+const Statement& Assignment::GetValue() const {
+    return *rv_;
 }
 
-VariableValue::VariableValue(std::vector<std::string> dotted_ids)
-: dotted_ids_{std::move(dotted_ids)} {
+std::unique_ptr<Statement>& Assignment::GetValue() {
+    return rv_;
+}
+
+void Assignment::SetSlot(size_t slot) {
+    slot_ = slot;
+}
+
+VariableValue::VariableValue(runtime::Symbol var_name)
+: dotted_ids_{var_name}
+, caches_(1) {
+    assert(var_name.Str().find('.') == std::string::npos);
+}
+
+VariableValue::VariableValue(std::vector<runtime::Symbol> dotted_ids)
+: dotted_ids_{std::move(dotted_ids)}
+, caches_(dotted_ids_.size()) {
     assert(dotted_ids_.size() > 0);
 }
 
+VariableValue::VariableValue(const std::vector<std::string>& dotted_ids)
+: VariableValue(std::vector<runtime::Symbol>(dotted_ids.begin(), dotted_ids.end())) {
+}
+
 ObjectHolder VariableValue::Execute(Closure& closure, Context& /*context*/) {
-    Closure::const_iterator it = closure.find(dotted_ids_[0]);
-    
-    if(it == closure.end()) {
-        throw std::runtime_error("Unknown fild " + dotted_ids_[0]);
+    const ObjectHolder* value = nullptr;
+    if(slot_ < closure.FrameSize()) {
+        value = &closure.Slot(slot_);
+        if(value->IsUnbound()) {
+            throw std::runtime_error("Unknown fild " + dotted_ids_[0].Str());
+        }
+    } else {
+        value = closure.Find(dotted_ids_[0], caches_[0]);
+        if(value == nullptr) {
+            throw std::runtime_error("Unknown fild " + dotted_ids_[0].Str());
+        }
     }
     
     for(size_t i = 1; i < dotted_ids_.size(); ++i) {
-        const ClassInstance* pclass_instance = it->second.TryAs<ClassInstance>();
+        const ClassInstance* pclass_instance = value->TryAs<ClassInstance>();
         assert(pclass_instance != nullptr);
-        const Closure& fields = pclass_instance->Fields();
-        it = fields.find(dotted_ids_[i]);
-        if(it == fields.end()) {
-            throw std::runtime_error("Unknown fild " + dotted_ids_[i]);
+        value = pclass_instance->Fields().Find(dotted_ids_[i], caches_[i]);
+        if(value == nullptr) {
+            throw std::runtime_error("Unknown fild " + dotted_ids_[i].Str());
         }
     }
     
-    return it->second;
+    return *value;
+}
+
+const std::vector<runtime::Symbol>& VariableValue::GetDottedIds() const {
+    return dotted_ids_;
+}
+
+void VariableValue::SetSlot(size_t slot) {
+    slot_ = slot;
 }
 
 unique_ptr<Print> Print::Variable(const std::string& name) {
@@ -105,30 +160,102 @@ ObjectHolder Print::Execute(Closure& closure, Context& context) {
     return {};
 }
 
-MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
+const std::vector<std::unique_ptr<Statement>>& Print::GetArgs() const {
+    return args_;
+}
+
+std::vector<std::unique_ptr<Statement>>& Print::GetArgs() {
+    return args_;
+}
+
+MethodCall::MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method,
                        std::vector<std::unique_ptr<Statement>> args)
 : object_{std::move(object)}
 , method_{std::move(method)}
+, method_id_{runtime::InternMethodName(method_)}
 , args_{std::move(args)} {
 }
 
+const runtime::Method* MethodCache::LookupSlow(const runtime::Class& cls, runtime::MethodId method,
+                                               size_t argument_count) {
+    ++stats_.misses;
+    ++total_.misses;
+    const runtime::Method* pmethod = cls.GetMethod(method);
+    if(pmethod == nullptr || pmethod->formal_params.size() != argument_count) {
+        return nullptr;
+    }
+    Entry& entry = size_ < CAPACITY ? entries_[size_++] : entries_[next_victim_++ % CAPACITY];
+    entry = {cls.GetId(), pmethod};
+    return pmethod;
+}
+
 ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
     auto obj = object_->Execute(closure, context);
     if(ClassInstance* class_instance = obj.TryAs<ClassInstance>()) {
+        const Method& method = FindMethod(*class_instance);
+        if(method.frame_size != 0) {
+            // Аргументы вычисляются сразу в слоты кадра вызываемого метода
+            const runtime::CallStack::Frame frame(method.frame_size);
+            for(size_t i = 0; i < args_.size(); ++i) {
+                frame.Slots()[i] = args_[i]->Execute(closure, context);
+            }
+            return class_instance->CallInFrame(method, frame.Slots(), context);
+        }
         std::vector<ObjectHolder> actual_args;
+        actual_args.reserve(args_.size());
         for(auto& arg: args_) {
             actual_args.push_back(arg->Execute(closure, context));
         }
-        return class_instance->Call(method_, actual_args, context);
+        return class_instance->Call(method, actual_args, context);
     }
     throw std::runtime_error("Call method for not class type");
 }
+
+const Method& MethodCall::FindMethod(const ClassInstance& instance) {
+    const Method* method = cache_.Lookup(instance.GetClass(), method_id_, args_.size());
+    if(method == nullptr) {
+        throw std::runtime_error("Method: "s + method_.Str() + " does not exist"s);
+    }
+    return *method;
+}
+
+const Statement& MethodCall::GetObject() const {
+    return *object_;
+}
+
+std::unique_ptr<Statement>& MethodCall::GetObject() {
+    return object_;
+}
+
+runtime::Symbol MethodCall::GetMethod() const {
+    return method_;
+}
+
+const MethodCache& MethodCall::GetCache() const {
+    return cache_;
+}
+
+const std::vector<std::unique_ptr<Statement>>& MethodCall::GetArgs() const {
+    return args_;
+}
+
+std::vector<std::unique_ptr<Statement>>& MethodCall::GetArgs() {
+    return args_;
+}
     
 UnaryOperation::UnaryOperation(std::unique_ptr<Statement> argument)
 : argument_{std::move(argument)}{
     
 }
 
+const Statement& UnaryOperation::GetArgument() const {
+    return *argument_;
+}
+
+std::unique_ptr<Statement>& UnaryOperation::GetArgument() {
+    return argument_;
+}
+
 ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
     std::stringstream ss;
     runtime::SimpleContext simple_context(ss);
@@ -142,12 +269,28 @@ BinaryOperation::BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr
     
 }
 
+const Statement& BinaryOperation::GetLhs() const {
+    return *lhs_;
+}
+
+std::unique_ptr<Statement>& BinaryOperation::GetLhs() {
+    return lhs_;
+}
+
+const Statement& BinaryOperation::GetRhs() const {
+    return *rhs_;
+}
+
+std::unique_ptr<Statement>& BinaryOperation::GetRhs() {
+    return rhs_;
+}
+
 ObjectHolder Add::Execute(Closure& closure, Context& context) {
     auto lhs = lhs_->Execute(closure, context);
     auto rhs = rhs_->Execute(closure, context);
-    if(runtime::Number* lnumber = lhs.TryAs<runtime::Number>()) {
-        if(runtime::Number* rnumber = rhs.TryAs<runtime::Number>()) {
-            return ObjectHolder::Own(runtime::Number{lnumber->GetValue() + rnumber->GetValue()});
+    if(const int* lnumber = lhs.TryAsValue<runtime::Number>()) {
+        if(const int* rnumber = rhs.TryAsValue<runtime::Number>()) {
+            return ObjectHolder::Own(runtime::Number{*lnumber + *rnumber});
         }
     } else if(runtime::String* lstring = lhs.TryAs<runtime::String>()) {
         if(runtime::String* rstring = rhs.TryAs<runtime::String>()) {
@@ -166,9 +309,9 @@ ObjectHolder Add::Execute(Closure& closure, Context& context) {
 ObjectHolder Sub::Execute(Closure& closure, Context& context) {
     auto lhs = lhs_->Execute(closure, context);
     auto rhs = rhs_->Execute(closure, context);
-    if(runtime::Number* lnumber = lhs.TryAs<runtime::Number>()) {
-        if(runtime::Number* rnumber = rhs.TryAs<runtime::Number>()) {
-            return ObjectHolder::Own(runtime::Number{lnumber->GetValue() - rnumber->GetValue()});
+    if(const int* lnumber = lhs.TryAsValue<runtime::Number>()) {
+        if(const int* rnumber = rhs.TryAsValue<runtime::Number>()) {
+            return ObjectHolder::Own(runtime::Number{*lnumber - *rnumber});
         }
     } else if(ClassInstance* lclass_instance = lhs.TryAs<ClassInstance>()) {
         if(lclass_instance->HasMethod(SUB_METHOD, 1)) {
@@ -183,9 +326,9 @@ ObjectHolder Sub::Execute(Closure& closure, Context& context) {
 ObjectHolder Mult::Execute(Closure& closure, Context& context) {
     auto lhs = lhs_->Execute(closure, context);
     auto rhs = rhs_->Execute(closure, context);
-    if(runtime::Number* lnumber = lhs.TryAs<runtime::Number>()) {
-        if(runtime::Number* rnumber = rhs.TryAs<runtime::Number>()) {
-            return ObjectHolder::Own(runtime::Number{lnumber->GetValue() * rnumber->GetValue()});
+    if(const int* lnumber = lhs.TryAsValue<runtime::Number>()) {
+        if(const int* rnumber = rhs.TryAsValue<runtime::Number>()) {
+            return ObjectHolder::Own(runtime::Number{*lnumber * *rnumber});
         }
     } else if(ClassInstance* lclass_instance = lhs.TryAs<ClassInstance>()) {
         if(lclass_instance->HasMethod(MUL_METHOD, 1)) {
@@ -200,10 +343,10 @@ ObjectHolder Mult::Execute(Closure& closure, Context& context) {
 ObjectHolder Div::Execute(Closure& closure, Context& context) {
     auto lhs = lhs_->Execute(closure, context);
     auto rhs = rhs_->Execute(closure, context);
-    if(runtime::Number* lnumber = lhs.TryAs<runtime::Number>()) {
-        if(runtime::Number* rnumber = rhs.TryAs<runtime::Number>()) {
-            if(rnumber->GetValue()) {
-                return ObjectHolder::Own(runtime::Number{lnumber->GetValue() / rnumber->GetValue()});
+    if(const int* lnumber = lhs.TryAsValue<runtime::Number>()) {
+        if(const int* rnumber = rhs.TryAsValue<runtime::Number>()) {
+            if(*rnumber) {
+                return ObjectHolder::Own(runtime::Number{*lnumber / *rnumber});
             } else {
                 throw std::runtime_error("Div0");
             }
@@ -224,22 +367,27 @@ void Compound::AddStatement(std::unique_ptr<Statement> stmt) {
 }
 
 ObjectHolder Compound::Execute(Closure& closure, Context& context) {
-    for(auto& instruction: instructions_) {
-        if (dynamic_cast<Return*>(instruction.get())) {
-            return instruction->Execute(closure, context);
-        }
+    ObjectHolder result;
+    Run(closure, context, result);
+    return result;
+}
 
-        if (dynamic_cast<IfElse*>(instruction.get())) {
-            auto result = instruction->Execute(closure, context);
-            if (result) {
-                return result;
-            }
-        }
-        else {
-            instruction->Execute(closure, context);
+Completion Compound::Run(Closure& closure, Context& context, ObjectHolder& result) {
+    for(auto& instruction: instructions_) {
+        const Completion completion = instruction->Run(closure, context, result);
+        if (completion != Completion::Normal) {
+            return completion;
         }
     }
-    return {};
+    return Completion::Normal;
+}
+
+const std::vector<std::unique_ptr<Statement>>& Compound::GetStatements() const {
+    return instructions_;
+}
+
+std::vector<std::unique_ptr<Statement>>& Compound::GetStatements() {
+    return instructions_;
 }
 
 Return::Return(std::unique_ptr<Statement> statement)
@@ -251,6 +399,63 @@ ObjectHolder Return::Execute(Closure& closure, Context& context) {
     return statement_->Execute(closure, context);
 }
 
+Completion Return::Run(Closure& closure, Context& context, ObjectHolder& result) {
+    result = statement_->Execute(closure, context);
+    return Completion::Return;
+}
+
+const Statement& Return::GetStatement() const {
+    return *statement_;
+}
+
+std::unique_ptr<Statement>& Return::GetStatement() {
+    return statement_;
+}
+
+TailCall::TailCall(std::unique_ptr<MethodCall> call, const MethodBody& owner, size_t first_temp)
+: Return{std::move(call)}
+, call_{static_cast<MethodCall&>(*GetStatement())}
+, owner_{owner}
+, first_temp_{first_temp} {
+}
+
+Completion TailCall::Run(Closure& closure, Context& context, ObjectHolder& result) {
+    ObjectHolder self = call_.GetObject()->Execute(closure, context);
+    ClassInstance* instance = self.TryAs<ClassInstance>();
+    if(instance == nullptr) {
+        throw std::runtime_error("Call method for not class type");
+    }
+    auto& args = call_.GetArgs();
+    for(size_t i = 0; i < args.size(); ++i) {
+        closure.Slot(first_temp_ + i) = args[i]->Execute(closure, context);
+    }
+
+    const Method& method = call_.FindMethod(*instance);
+    if(method.body.get() != &owner_) {
+        std::vector<ObjectHolder> actual_args;
+        actual_args.reserve(args.size());
+        for(size_t i = 0; i < args.size(); ++i) {
+            actual_args.push_back(std::move(closure.Slot(first_temp_ + i)));
+        }
+        result = instance->Call(method, actual_args, context);
+        return Completion::Return;
+    }
+
+    // Кадр становится таким же, каким его создаёт новый вызов метода
+    for(size_t i = 0; i < args.size(); ++i) {
+        closure.Slot(i) = std::move(closure.Slot(first_temp_ + i));
+    }
+    closure.Slot(args.size()) = std::move(self);
+    for(size_t i = args.size() + 1; i < first_temp_; ++i) {
+        closure.Slot(i) = ObjectHolder::Unbound();
+    }
+    return Completion::TailCall;
+}
+
+const MethodCall& TailCall::GetCall() const {
+    return call_;
+}
+
 ClassDefinition::ClassDefinition(ObjectHolder cls)
 : cls_{cls} {
 }
@@ -262,7 +467,11 @@ ObjectHolder ClassDefinition::Execute(Closure& closure, Context& /*context*/) {
     return {};
 }
 
-FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
+const ObjectHolder& ClassDefinition::GetClass() const {
+    return cls_;
+}
+
+FieldAssignment::FieldAssignment(VariableValue object, runtime::Symbol field_name,
                                  std::unique_ptr<Statement> rv)
 : object_{std::move(object)}
 , field_name_{std::move(field_name)}
@@ -275,7 +484,29 @@ ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
     ClassInstance *pclass_instance = var.TryAs<ClassInstance>();
     assert(pclass_instance);
     
-    return pclass_instance->Fields()[field_name_] = rv_->Execute(closure, context);
+    // Значение вычисляется до обращения к полю: вычисление может добавить поля объекту
+    ObjectHolder value = rv_->Execute(closure, context);
+    return pclass_instance->Fields().Emplace(field_name_, cache_) = std::move(value);
+}
+
+const VariableValue& FieldAssignment::GetObject() const {
+    return object_;
+}
+
+VariableValue& FieldAssignment::GetObject() {
+    return object_;
+}
+
+runtime::Symbol FieldAssignment::GetFieldName() const {
+    return field_name_;
+}
+
+const Statement& FieldAssignment::GetValue() const {
+    return *rv_;
+}
+
+std::unique_ptr<Statement>& FieldAssignment::GetValue() {
+    return rv_;
 }
 
 IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> if_body,
@@ -286,39 +517,231 @@ IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement>
 }
 
 ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
+    ObjectHolder result;
+    Run(closure, context, result);
+    return result;
+}
+
+Completion IfElse::Run(Closure& closure, Context& context, ObjectHolder& result) {
     auto condition = condition_->Execute(closure, context);
     if(IsTrue(condition)) {
-        return if_body_->Execute(closure, context);
-        
+        return if_body_->Run(closure, context, result);
     }
     if(else_body_) {
-        return else_body_->Execute(closure, context);
+        return else_body_->Run(closure, context, result);
     }
 
-    return {};
+    return Completion::Normal;
+}
+
+const Statement& IfElse::GetCondition() const {
+    return *condition_;
+}
+
+const Statement& IfElse::GetIfBody() const {
+    return *if_body_;
+}
+
+const Statement* IfElse::GetElseBody() const {
+    return else_body_.get();
+}
+
+std::unique_ptr<Statement>& IfElse::GetCondition() {
+    return condition_;
+}
+
+std::unique_ptr<Statement>& IfElse::GetIfBody() {
+    return if_body_;
+}
+
+std::unique_ptr<Statement>& IfElse::GetElseBody() {
+    return else_body_;
+}
+
+While::While(unique_ptr<Statement> condition, unique_ptr<Statement> body)
+: condition_{std::move(condition)}
+, body_{std::move(body)} {
+}
+
+ObjectHolder While::Execute(Closure& closure, Context& context) {
+    ObjectHolder result;
+    Run(closure, context, result);
+    return result;
+}
+
+Completion While::Run(Closure& closure, Context& context, ObjectHolder& result) {
+    while(IsTrue(condition_->Execute(closure, context))) {
+        const Completion completion = body_->Run(closure, context, result);
+        if(completion == Completion::Break) {
+            break;
+        }
+        if(completion == Completion::Return || completion == Completion::TailCall) {
+            return completion;
+        }
+    }
+    return Completion::Normal;
+}
+
+const Statement& While::GetCondition() const {
+    return *condition_;
+}
+
+std::unique_ptr<Statement>& While::GetCondition() {
+    return condition_;
+}
+
+const Statement& While::GetBody() const {
+    return *body_;
+}
+
+std::unique_ptr<Statement>& While::GetBody() {
+    return body_;
+}
+
+ForRange::ForRange(runtime::Symbol var, unique_ptr<Statement> start, unique_ptr<Statement> stop,
+                   unique_ptr<Statement> step, unique_ptr<Statement> body)
+: var_{var}
+, start_{std::move(start)}
+, stop_{std::move(stop)}
+, step_{std::move(step)}
+, body_{std::move(body)} {
+}
+
+ObjectHolder ForRange::Execute(Closure& closure, Context& context) {
+    ObjectHolder result;
+    Run(closure, context, result);
+    return result;
+}
+
+Completion ForRange::Run(Closure& closure, Context& context, ObjectHolder& result) {
+    const ObjectHolder start_value = start_->Execute(closure, context);
+    const ObjectHolder stop_value = stop_->Execute(closure, context);
+    const ObjectHolder step_value = step_->Execute(closure, context);
+    const int start = GetRangeArgument(start_value);
+    const int stop = GetRangeArgument(stop_value);
+    const int step = GetRangeArgument(step_value);
+    if(step == 0) {
+        throw std::runtime_error("range() step must not be zero"s);
+    }
+
+    // Счётчик шире int, чтобы последний шаг за границу диапазона не переполнял его
+    for(int64_t i = start; step > 0 ? i < stop : i > stop; i += step) {
+        // Число хранится внутри ObjectHolder, поэтому итерация не выделяет память
+        ObjectHolder value = ObjectHolder::Own(runtime::Number{static_cast<int>(i)});
+        if(slot_ < closure.FrameSize()) {
+            closure.Slot(slot_) = std::move(value);
+        } else {
+            closure.Emplace(var_, cache_) = std::move(value);
+        }
+
+        const Completion completion = body_->Run(closure, context, result);
+        if(completion == Completion::Break) {
+            break;
+        }
+        if(completion == Completion::Return || completion == Completion::TailCall) {
+            return completion;
+        }
+    }
+    return Completion::Normal;
+}
+
+runtime::Symbol ForRange::GetVar() const {
+    return var_;
+}
+
+const Statement& ForRange::GetStart() const {
+    return *start_;
+}
+
+std::unique_ptr<Statement>& ForRange::GetStart() {
+    return start_;
+}
+
+const Statement& ForRange::GetStop() const {
+    return *stop_;
+}
+
+std::unique_ptr<Statement>& ForRange::GetStop() {
+    return stop_;
+}
+
+const Statement& ForRange::GetStep() const {
+    return *step_;
+}
+
+std::unique_ptr<Statement>& ForRange::GetStep() {
+    return step_;
+}
+
+const Statement& ForRange::GetBody() const {
+    return *body_;
+}
+
+std::unique_ptr<Statement>& ForRange::GetBody() {
+    return body_;
+}
+
+void ForRange::SetSlot(size_t slot) {
+    slot_ = slot;
+}
+
+ObjectHolder Break::Execute(Closure& /*closure*/, Context& /*context*/) {
+    throw std::runtime_error("'break' outside loop"s);
+}
+
+Completion Break::Run(Closure& /*closure*/, Context& /*context*/, ObjectHolder& /*result*/) {
+    return Completion::Break;
+}
+
+ObjectHolder Continue::Execute(Closure& /*closure*/, Context& /*context*/) {
+    throw std::runtime_error("'continue' outside loop"s);
+}
+
+Completion Continue::Run(Closure& /*closure*/, Context& /*context*/, ObjectHolder& /*result*/) {
+    return Completion::Continue;
 }
 
 ObjectHolder Not::Execute(Closure& closure, Context& context) {
     auto argument = argument_->Execute(closure, context);
-    if(runtime::Bool* b = argument.TryAs<runtime::Bool>()) {
-        return ObjectHolder::Own(runtime::Bool{!b->GetValue()});
+    if(const bool* b = argument.TryAsValue<runtime::Bool>()) {
+        return ObjectHolder::Own(runtime::Bool{!*b});
     }
     
     throw std::runtime_error("not for not bool val");
 }
 
-Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
-    : BinaryOperation(std::move(lhs), std::move(rhs))
-    , cmp_{std::move(cmp)}{
+ObjectHolder Negate::Execute(Closure& closure, Context& context) {
+    auto argument = argument_->Execute(closure, context);
+    if (const int* number = argument.TryAsValue<runtime::Number>()) {
+        return ObjectHolder::Own(runtime::Number{-*number});
+    }
+    if (ClassInstance* instance = argument.TryAs<ClassInstance>()) {
+        if (instance->HasMethod(MUL_METHOD, 1)) {
+            std::vector<ObjectHolder> actual_args;
+            actual_args.emplace_back(ObjectHolder::Own(runtime::Number{-1}));
+            return instance->Call(MUL_METHOD, actual_args, context);
+        }
+    }
+    throw std::runtime_error("Mult with diferent types");
 }
 
-ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
-    bool result = cmp_(
-        lhs_->Execute(closure, context),
-        rhs_->Execute(closure, context),
-        context
-    );
-    return ObjectHolder::Own(runtime::Bool(result));
+unique_ptr<Comparison> MakeComparison(Comparator cmp, unique_ptr<Statement> lhs,
+                                      unique_ptr<Statement> rhs) {
+    switch (cmp) {
+        case Comparator::Equal:
+            return make_unique<ComparisonOperation<Comparator::Equal>>(move(lhs), move(rhs));
+        case Comparator::NotEqual:
+            return make_unique<ComparisonOperation<Comparator::NotEqual>>(move(lhs), move(rhs));
+        case Comparator::Less:
+            return make_unique<ComparisonOperation<Comparator::Less>>(move(lhs), move(rhs));
+        case Comparator::Greater:
+            return make_unique<ComparisonOperation<Comparator::Greater>>(move(lhs), move(rhs));
+        case Comparator::LessOrEqual:
+            return make_unique<ComparisonOperation<Comparator::LessOrEqual>>(move(lhs), move(rhs));
+        case Comparator::GreaterOrEqual:
+            return make_unique<ComparisonOperation<Comparator::GreaterOrEqual>>(move(lhs), move(rhs));
+    }
+    throw std::runtime_error("Unknown comparator"s);
 }
 
 NewInstance::NewInstance(const runtime::Class& local_class, std::vector<std::unique_ptr<Statement>> args)
@@ -354,12 +777,91 @@ ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
     return class_instance;
 }
 
+const runtime::Class& NewInstance::GetClass() const {
+    return class_;
+}
+
+const std::vector<std::unique_ptr<Statement>>& NewInstance::GetArgs() const {
+    return args_;
+}
+
+std::vector<std::unique_ptr<Statement>>& NewInstance::GetArgs() {
+    return args_;
+}
+
+void* Statement::operator new(size_t size) {
+    if(Arena* arena = ArenaScope::Current()) {
+        // Размер объекта кратен его выравниванию, поэтому младший бит размера
+        // даёт достаточное выравнивание
+        const size_t align = std::min(size & (~size + 1), alignof(max_align_t));
+        return arena->Allocate(size, align);
+    }
+    return ::operator new(size);
+}
+
+void Statement::operator delete(void* ptr) noexcept {
+    const Arena* arena = ArenaScope::Current();
+    if(arena && arena->Contains(ptr)) {
+        return;
+    }
+    ::operator delete(ptr);
+}
+
+Completion Statement::Run(Closure& closure, Context& context, ObjectHolder& /*result*/) {
+    Execute(closure, context);
+    return Completion::Normal;
+}
+
 MethodBody::MethodBody(std::unique_ptr<Statement>&& body) : body_{ std::move(body) } {
+    if(Arena* arena = ArenaScope::Current()) {
+        arena_ = arena->shared_from_this();
+    }
+}
+
+MethodBody::~MethodBody() {
+    ArenaScope scope(arena_);
+    body_.reset();
 }
 
 ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
+    ObjectHolder result;
+    while(body_->Run(closure, context, result) == Completion::TailCall) {
+    }
+    return result;
+}
 
+const Statement& MethodBody::GetBody() const {
+    return *body_;
+}
+
+std::unique_ptr<Statement>& MethodBody::GetBody() {
+    return body_;
+}
+
+Program::Program(std::shared_ptr<Arena> arena, std::unique_ptr<Statement> body)
+: arena_{ std::move(arena) }
+, body_{ std::move(body) } {
+}
+
+Program::~Program() {
+    ArenaScope scope(arena_);
+    body_.reset();
+}
+
+ObjectHolder Program::Execute(Closure& closure, Context& context) {
     return body_->Execute(closure, context);
 }
 
+const Statement& Program::GetBody() const {
+    return *body_;
+}
+
+std::unique_ptr<Statement>& Program::GetBody() {
+    return body_;
+}
+
+const Arena* Program::GetArena() const {
+    return arena_.get();
+}
+
 }  // namespace ast
\ No newline at end of file
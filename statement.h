@@ -1,12 +1,58 @@
 #pragma once
 
+#include "arena.h"
 #include "runtime.h"
 
-#include <functional>
+#include <array>
+#include <cstdint>
 
 namespace ast {
 
-using Statement = runtime::Executable;
+// Результат выполнения инструкции
+enum class Completion : uint8_t {
+    // Выполнение продолжается со следующей инструкции
+    Normal,
+    // Выполнена инструкция return: объемлющие блоки завершаются до тела метода
+    Return,
+    // Выполнена инструкция break: блоки завершаются до ближайшего цикла, и цикл прекращается
+    Break,
+    // Выполнена инструкция continue: блоки завершаются до ближайшего цикла,
+    // и цикл переходит к следующей итерации
+    Continue,
+    // Выполнен хвостовой вызов метода самого себя: аргументы уже записаны в кадр,
+    // и тело метода выполняется заново без нового вызова
+    TailCall,
+};
+
+// Узел AST. Если узел создаётся внутри ArenaScope, он размещается в арене этой области,
+// иначе - в куче. Память узла в арене освобождается вместе с ареной, поэтому узлы из арены
+// удаляются только внутри ArenaScope с той же ареной (так их удаляют Program и MethodBody)
+class Statement : public runtime::Executable {
+public:
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr) noexcept;
+
+    // Выполняет узел как инструкцию и сообщает, как продолжить выполнение объемлющего блока.
+    // Если узел выполнил return, записывает возвращаемое значение в result.
+    // По умолчанию вызывает Execute и возвращает Completion::Normal
+    virtual Completion Run(runtime::Closure& closure, runtime::Context& context,
+                           runtime::ObjectHolder& result);
+};
+
+// Узел, который всегда размещается в куче, даже внутри ArenaScope.
+// Такие узлы владеют ареной и не должны находиться в ней сами
+class HeapStatement : public Statement {
+public:
+    static void* operator new(size_t size) {
+        return ::operator new(size);
+    }
+    static void operator delete(void* ptr) noexcept {
+        ::operator delete(ptr);
+    }
+};
+
+// Номер слота кадра для переменных, которые ищутся по имени
+inline constexpr size_t NO_SLOT = static_cast<size_t>(-1);
 
 // Выражение, возвращающее значение типа T,
 // используется как основа для создания констант
@@ -14,16 +60,46 @@ template <typename T>
 class ValueStatement : public Statement {
 public:
     explicit ValueStatement(T v)
-        : value_(std::move(v)) {
+        : value_(MakeValue(std::move(v))) {
     }
 
     runtime::ObjectHolder Execute(runtime::Closure& /*closure*/,
                                   runtime::Context& /*context*/) override {
-        return runtime::ObjectHolder::Share(value_);
+        if constexpr (IS_IMMEDIATE) {
+            // Числа и логические значения копируются внутрь ObjectHolder без выделения памяти
+            return runtime::ObjectHolder::Own(T(value_));
+        } else {
+            // Остальные константы разделяются со значением узла, тоже без выделения памяти
+            return value_;
+        }
+    }
+
+    [[nodiscard]] const T& GetValue() const {
+        if constexpr (IS_IMMEDIATE) {
+            return value_;
+        } else {
+            return *value_.template TryAs<T>();
+        }
     }
 
 private:
-    T value_;
+    static constexpr bool IS_IMMEDIATE
+        = std::is_same_v<T, runtime::Number> || std::is_same_v<T, runtime::Bool>;
+
+    // Остальные константы хранятся в куче со счётчиком ссылок, а не в узле:
+    // значение может пережить узел, например в режиме --stream, где инструкция
+    // удаляется вместе со своей ареной сразу после выполнения
+    using Value = std::conditional_t<IS_IMMEDIATE, T, runtime::ObjectHolder>;
+
+    static Value MakeValue(T v) {
+        if constexpr (IS_IMMEDIATE) {
+            return v;
+        } else {
+            return runtime::ObjectHolder::Own(std::move(v));
+        }
+    }
+
+    Value value_;
 };
 
 using NumericConst = ValueStatement<runtime::Number>;
@@ -37,37 +113,62 @@ x = circle.center.x
 */
 class VariableValue : public Statement {
 public:
-    explicit VariableValue(const std::string& var_name);
-    explicit VariableValue(std::vector<std::string> dotted_ids);
+    explicit VariableValue(runtime::Symbol var_name);
+    explicit VariableValue(std::vector<runtime::Symbol> dotted_ids);
+    explicit VariableValue(const std::vector<std::string>& dotted_ids);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const std::vector<runtime::Symbol>& GetDottedIds() const;
+
+    // Связывает первый идентификатор цепочки со слотом кадра метода
+    void SetSlot(size_t slot);
     
 private:
-    std::vector<std::string> dotted_ids_;
+    std::vector<runtime::Symbol> dotted_ids_;
+    // Кэши доступа к каждому идентификатору цепочки
+    std::vector<runtime::FieldCache> caches_;
+    size_t slot_ = NO_SLOT;
 };
 
 // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
 class Assignment : public Statement {
 public:
-    Assignment(std::string var, std::unique_ptr<Statement> rv);
+    Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] runtime::Symbol GetVar() const;
+    [[nodiscard]] const Statement& GetValue() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetValue();
+
+    // Связывает переменную со слотом кадра метода
+    void SetSlot(size_t slot);
 private:
-    std::string var_;
+    runtime::Symbol var_;
     std::unique_ptr<Statement> rv_;
+    runtime::FieldCache cache_;
+    size_t slot_ = NO_SLOT;
 };
 
 // Присваивает полю object.field_name значение выражения rv
 class FieldAssignment : public Statement {
 public:
-    FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+    FieldAssignment(VariableValue object, runtime::Symbol field_name, std::unique_ptr<Statement> rv);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const VariableValue& GetObject() const;
+    [[nodiscard]] VariableValue& GetObject();
+    [[nodiscard]] runtime::Symbol GetFieldName() const;
+    [[nodiscard]] const Statement& GetValue() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetValue();
     
 private:
     VariableValue object_;
-    std::string field_name_;
+    runtime::Symbol field_name_;
     std::unique_ptr<Statement> rv_;
+    runtime::FieldCache cache_;
 };
 
 // Значение None
@@ -93,21 +194,91 @@ public:
     // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
     // context.GetOutputStream()
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const;
+    [[nodiscard]] std::vector<std::unique_ptr<Statement>>& GetArgs();
 private:
     std::vector<std::unique_ptr<Statement>> args_;
 };
 
+// Количество попаданий и промахов кэша методов
+struct MethodCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+// Встроенный кэш точки вызова метода. Запоминает найденные методы для нескольких
+// классов получателя, поэтому повторный вызов у объекта того же класса обходится
+// без поиска метода по имени в классе и его родителях
+class MethodCache {
+public:
+    static constexpr size_t CAPACITY = 4;
+
+    using Stats = MethodCacheStats;
+
+    // Возвращает метод с номером имени method класса cls, принимающий argument_count
+    // параметров, либо nullptr, если такого метода нет
+    const runtime::Method* Lookup(const runtime::Class& cls, runtime::MethodId method,
+                                  size_t argument_count) {
+        for (size_t i = 0; i < size_; ++i) {
+            if (entries_[i].class_id == cls.GetId()) {
+                ++stats_.hits;
+                ++total_.hits;
+                return entries_[i].method;
+            }
+        }
+        return LookupSlow(cls, method, argument_count);
+    }
+
+    [[nodiscard]] Stats GetStats() const {
+        return stats_;
+    }
+
+    // Суммарная статистика всех кэшей
+    [[nodiscard]] static Stats GetTotalStats() {
+        return total_;
+    }
+
+private:
+    const runtime::Method* LookupSlow(const runtime::Class& cls, runtime::MethodId method,
+                                      size_t argument_count);
+
+    struct Entry {
+        std::uint64_t class_id = 0;
+        const runtime::Method* method = nullptr;
+    };
+
+    std::array<Entry, CAPACITY> entries_{};
+    size_t size_ = 0;
+    // Запись, которую заменит следующий промах, когда кэш заполнен
+    size_t next_victim_ = 0;
+    Stats stats_;
+    static inline Stats total_;
+};
+
 // Вызывает метод object.method со списком параметров args
 class MethodCall : public Statement {
 public:
-    MethodCall(std::unique_ptr<Statement> object, std::string method,
+    MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method,
                std::vector<std::unique_ptr<Statement>> args);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const Statement& GetObject() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetObject();
+    [[nodiscard]] runtime::Symbol GetMethod() const;
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const;
+    [[nodiscard]] std::vector<std::unique_ptr<Statement>>& GetArgs();
+    [[nodiscard]] const MethodCache& GetCache() const;
+
+    // Находит вызываемый метод в классе instance. Выбрасывает runtime_error, если его нет
+    const runtime::Method& FindMethod(const runtime::ClassInstance& instance);
 private:
     std::unique_ptr<Statement> object_;
-    std::string method_;
+    runtime::Symbol method_;
+    runtime::MethodId method_id_;
     std::vector<std::unique_ptr<Statement>> args_;
+    MethodCache cache_;
 };
 
 /*
@@ -129,6 +300,10 @@ public:
     NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
     // Возвращает объект, содержащий значение типа ClassInstance
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const runtime::Class& GetClass() const;
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const;
+    [[nodiscard]] std::vector<std::unique_ptr<Statement>>& GetArgs();
 private:
     const runtime::Class& class_;
     std::vector<std::unique_ptr<Statement>> args_;
@@ -138,6 +313,9 @@ private:
 class UnaryOperation : public Statement {
 public:
     explicit UnaryOperation(std::unique_ptr<Statement> argument);
+
+    [[nodiscard]] const Statement& GetArgument() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetArgument();
 protected:
     std::unique_ptr<Statement> argument_;
 };
@@ -153,6 +331,11 @@ public:
 class BinaryOperation : public Statement {
 public:
     BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
+
+    [[nodiscard]] const Statement& GetLhs() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetLhs();
+    [[nodiscard]] const Statement& GetRhs() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetRhs();
 protected:
     std::unique_ptr<Statement> lhs_;
     std::unique_ptr<Statement> rhs_;
@@ -215,13 +398,13 @@ public:
     // после приведения к Bool не равно short_val
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override {
         auto lhs = lhs_->Execute(closure, context);
-        if (runtime::Bool* lbool = lhs.TryAs<runtime::Bool>()) {
-            if (lbool->GetValue() == short_val) {
+        if (const bool* lbool = lhs.TryAsValue<runtime::Bool>()) {
+            if (*lbool == short_val) {
                 return runtime::ObjectHolder::Own(runtime::Bool{ short_val });
             }
             auto rhs = rhs_->Execute(closure, context);
-            if (runtime::Bool* rbool = rhs.TryAs<runtime::Bool>()) {
-                return runtime::ObjectHolder::Own(runtime::Bool{ rbool->GetValue() });
+            if (const bool* rbool = rhs.TryAsValue<runtime::Bool>()) {
+                return runtime::ObjectHolder::Own(runtime::Bool{ *rbool });
             }
         }
 
@@ -242,6 +425,14 @@ public:
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 };
 
+// Унарный минус. Для числа возвращает число с противоположным знаком, а объект
+// пользовательского класса умножает на -1 методом __mul__, как выражение x * -1
+class Negate : public UnaryOperation {
+public:
+    using UnaryOperation::UnaryOperation;
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+};
+
 // Составная инструкция (например: тело метода, содержимое ветки if, либо else)
 class Compound : public Statement {
 public:
@@ -254,22 +445,52 @@ public:
     // Добавляет очередную инструкцию в конец составной инструкции
     void AddStatement(std::unique_ptr<Statement> stmt);
 
-    // Последовательно выполняет добавленные инструкции. Возвращает None
+    // Последовательно выполняет добавленные инструкции. Возвращает None,
+    // а если одна из них выполнила return - результат return
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    // Выполняет инструкции до первой, которая завершилась не Completion::Normal
+    Completion Run(runtime::Closure& closure, runtime::Context& context,
+                   runtime::ObjectHolder& result) override;
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetStatements() const;
+    [[nodiscard]] std::vector<std::unique_ptr<Statement>>& GetStatements();
 private:
     std::vector<std::unique_ptr<Statement>> instructions_;
 };
 
-// Тело метода. Как правило, содержит составную инструкцию
-class MethodBody : public Statement {
+// Тело метода. Как правило, содержит составную инструкцию. Удерживает арену, в которой
+// размещены узлы body, поэтому класс может пережить программу, в которой был объявлен
+class MethodBody : public HeapStatement {
 public:
     explicit MethodBody(std::unique_ptr<Statement>&& body);
+    ~MethodBody() override;
 
     // Вычисляет инструкцию, переданную в качестве body.
     // Если внутри body была выполнена инструкция return, возвращает результат return
-    // В противном случае возвращает None
+    // В противном случае возвращает None. После хвостового вызова (TailCall) тело
+    // выполняется заново с тем же кадром
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const Statement& GetBody() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetBody();
+private:
+    std::shared_ptr<Arena> arena_;
+    std::unique_ptr<Statement> body_;
+};
+
+// Программа, которую возвращает ParseProgram. Владеет ареной с узлами программы
+class Program : public HeapStatement {
+public:
+    Program(std::shared_ptr<Arena> arena, std::unique_ptr<Statement> body);
+    ~Program() override;
+
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const Statement& GetBody() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetBody();
+    [[nodiscard]] const Arena* GetArena() const;
 private:
+    std::shared_ptr<Arena> arena_;
     std::unique_ptr<Statement> body_;
 };
 
@@ -281,10 +502,38 @@ public:
     // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
     // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    Completion Run(runtime::Closure& closure, runtime::Context& context,
+                   runtime::ObjectHolder& result) override;
+
+    [[nodiscard]] const Statement& GetStatement() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetStatement();
 private:
     std::unique_ptr<Statement> statement_;
 };
 
+/*
+Инструкция return self.method(...) внутри тела метода method. Если у self вызывается
+тот же метод (его не переопределил класс-наследник), вызов не создаёт новый кадр:
+аргументы записываются в слоты параметров текущего кадра, остальные слоты очищаются,
+и тело метода выполняется заново. Поэтому глубина такой рекурсии не ограничена стеком.
+Иначе выполняется обычный вызов, и его результат возвращается как из return
+*/
+class TailCall : public Return {
+public:
+    // Аргументы вычисляются в слоты кадра [first_temp, first_temp + число аргументов),
+    // чтобы не затереть параметры, которые ещё нужны при вычислении следующих аргументов
+    TailCall(std::unique_ptr<MethodCall> call, const MethodBody& owner, size_t first_temp);
+
+    Completion Run(runtime::Closure& closure, runtime::Context& context,
+                   runtime::ObjectHolder& result) override;
+
+    [[nodiscard]] const MethodCall& GetCall() const;
+private:
+    MethodCall& call_;
+    const MethodBody& owner_;
+    size_t first_temp_;
+};
+
 // Объявляет класс
 class ClassDefinition : public Statement {
 public:
@@ -294,6 +543,8 @@ public:
     // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
     // конструктор
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const runtime::ObjectHolder& GetClass() const;
 private:
     runtime::ObjectHolder cls_;
 };
@@ -306,26 +557,182 @@ public:
            std::unique_ptr<Statement> else_body);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    // Выполняет выбранную ветку и передаёт её результат объемлющему блоку
+    Completion Run(runtime::Closure& closure, runtime::Context& context,
+                   runtime::ObjectHolder& result) override;
+
+    [[nodiscard]] const Statement& GetCondition() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetCondition();
+    [[nodiscard]] const Statement& GetIfBody() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetIfBody();
+    // Возвращает nullptr, если ветка else отсутствует
+    [[nodiscard]] const Statement* GetElseBody() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetElseBody();
 private:
     std::unique_ptr<Statement> condition_;
     std::unique_ptr<Statement> if_body_;
     std::unique_ptr<Statement> else_body_;
 };
 
+// Цикл while <condition>: <body>
+class While : public Statement {
+public:
+    While(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> body);
+
+    // Выполняет тело, пока значение condition истинно. Возвращает None,
+    // а если в теле выполнена инструкция return - её результат
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    Completion Run(runtime::Closure& closure, runtime::Context& context,
+                   runtime::ObjectHolder& result) override;
+
+    [[nodiscard]] const Statement& GetCondition() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetCondition();
+    [[nodiscard]] const Statement& GetBody() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetBody();
+private:
+    std::unique_ptr<Statement> condition_;
+    std::unique_ptr<Statement> body_;
+};
+
+/*
+ * Цикл for <var> in range(<start>, <stop>, <step>): <body>
+ * Границы и шаг вычисляются один раз до начала цикла и должны быть числами, шаг не равен нулю.
+ * Перед каждой итерацией переменной var присваивается очередное значение счётчика.
+ * Счётчик хранится вне переменной, поэтому присваивание var в теле не меняет число итераций
+ */
+class ForRange : public Statement {
+public:
+    ForRange(runtime::Symbol var, std::unique_ptr<Statement> start, std::unique_ptr<Statement> stop,
+             std::unique_ptr<Statement> step, std::unique_ptr<Statement> body);
+
+    // Выполняет цикл. Возвращает None, а если в теле выполнена инструкция return - её результат
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    Completion Run(runtime::Closure& closure, runtime::Context& context,
+                   runtime::ObjectHolder& result) override;
+
+    [[nodiscard]] runtime::Symbol GetVar() const;
+    [[nodiscard]] const Statement& GetStart() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetStart();
+    [[nodiscard]] const Statement& GetStop() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetStop();
+    [[nodiscard]] const Statement& GetStep() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetStep();
+    [[nodiscard]] const Statement& GetBody() const;
+    [[nodiscard]] std::unique_ptr<Statement>& GetBody();
+
+    // Связывает переменную цикла со слотом кадра метода
+    void SetSlot(size_t slot);
+private:
+    runtime::Symbol var_;
+    std::unique_ptr<Statement> start_;
+    std::unique_ptr<Statement> stop_;
+    std::unique_ptr<Statement> step_;
+    std::unique_ptr<Statement> body_;
+    runtime::FieldCache cache_;
+    size_t slot_ = NO_SLOT;
+};
+
+// Инструкция break. Синтаксический анализатор допускает её только внутри цикла
+class Break : public Statement {
+public:
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    Completion Run(runtime::Closure& closure, runtime::Context& context,
+                   runtime::ObjectHolder& result) override;
+};
+
+// Инструкция continue. Синтаксический анализатор допускает её только внутри цикла
+class Continue : public Statement {
+public:
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    Completion Run(runtime::Closure& closure, runtime::Context& context,
+                   runtime::ObjectHolder& result) override;
+};
+
+// Вид операции сравнения. Порядок значений записывается в файл кэша программы
+enum class Comparator : uint8_t {
+    Equal,
+    NotEqual,
+    Less,
+    Greater,
+    LessOrEqual,
+    GreaterOrEqual,
+};
+
 // Операция сравнения
 class Comparison : public BinaryOperation {
 public:
-    // Comparator задаёт функцию, выполняющую сравнение значений аргументов
-    using Comparator = std::function<bool(const runtime::ObjectHolder&,
-                                          const runtime::ObjectHolder&, runtime::Context&)>;
+    using BinaryOperation::BinaryOperation;
 
-    Comparison(Comparator cmp, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
+    [[nodiscard]] virtual Comparator GetComparator() const = 0;
+};
+
+// Сравнение с оператором cmp. Пары чисел и пар строк сравниваются сразу после проверки
+// вида объектов, остальные значения - функциями runtime::Equal, runtime::Less и т.д.,
+// которые вызывают методы __eq__ и __lt__ у объектов пользовательских классов
+template <Comparator cmp>
+class ComparisonOperation final : public Comparison {
+public:
+    using Comparison::Comparison;
+
+    // Вычисляет значение выражений lhs и rhs и возвращает результат сравнения типа runtime::Bool
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override {
+        auto lhs = lhs_->Execute(closure, context);
+        auto rhs = rhs_->Execute(closure, context);
+        return runtime::ObjectHolder::Own(runtime::Bool{Compare(lhs, rhs, context)});
+    }
+
+    [[nodiscard]] Comparator GetComparator() const override {
+        return cmp;
+    }
+
+    static bool Compare(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs,
+                        runtime::Context& context) {
+        if (const int* lnum = lhs.TryAsValue<runtime::Number>()) {
+            if (const int* rnum = rhs.TryAsValue<runtime::Number>()) {
+                return Apply(*lnum, *rnum);
+            }
+        } else if (const auto* lstr = lhs.TryAs<runtime::String>()) {
+            if (const auto* rstr = rhs.TryAs<runtime::String>()) {
+                return Apply(lstr->GetValue(), rstr->GetValue());
+            }
+        }
+
+        if constexpr (cmp == Comparator::Equal) {
+            return runtime::Equal(lhs, rhs, context);
+        } else if constexpr (cmp == Comparator::NotEqual) {
+            return runtime::NotEqual(lhs, rhs, context);
+        } else if constexpr (cmp == Comparator::Less) {
+            return runtime::Less(lhs, rhs, context);
+        } else if constexpr (cmp == Comparator::Greater) {
+            return runtime::Greater(lhs, rhs, context);
+        } else if constexpr (cmp == Comparator::LessOrEqual) {
+            return runtime::LessOrEqual(lhs, rhs, context);
+        } else {
+            return runtime::GreaterOrEqual(lhs, rhs, context);
+        }
+    }
 
-    // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
-    // приведённый к типу runtime::Bool
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 private:
-    Comparator cmp_;
+    template <typename T>
+    static bool Apply(const T& lhs, const T& rhs) {
+        if constexpr (cmp == Comparator::Equal) {
+            return lhs == rhs;
+        } else if constexpr (cmp == Comparator::NotEqual) {
+            return lhs != rhs;
+        } else if constexpr (cmp == Comparator::Less) {
+            return lhs < rhs;
+        } else if constexpr (cmp == Comparator::Greater) {
+            return lhs > rhs;
+        } else if constexpr (cmp == Comparator::LessOrEqual) {
+            return lhs <= rhs;
+        } else {
+            return lhs >= rhs;
+        }
+    }
 };
 
+// Создаёт узел сравнения с оператором cmp
+std::unique_ptr<Comparison> MakeComparison(Comparator cmp, std::unique_ptr<Statement> lhs,
+                                           std::unique_ptr<Statement> rhs);
+
 }  // namespace ast
\ No newline at end of file
@@ -14,7 +14,9 @@ template <typename T>
 void AssertObjectValueEqual(const ObjectHolder& obj, const T& expected, const string& msg) {
     ostringstream one;
     runtime::DummyContext context;
-    obj->Print(one, context);
+    // Встроенное значение константного ObjectHolder печатается через копию
+    ObjectHolder boxed = obj;
+    boxed->Print(one, context);
 
     ostringstream two;
     two << expected;
@@ -472,6 +474,63 @@ void TestInheritance() {
     ASSERT(!cls.GetMethod("AsStringValue"s));
 }
 
+void TestMethodCallCache() {
+    auto make_class = [](const string& name, const runtime::Class* parent) {
+        vector<runtime::Method> methods;
+        methods.push_back({"GetName"s, {}, make_unique<StringConst>(name)});
+        return make_unique<runtime::Class>(name, move(methods), parent);
+    };
+    auto base = make_class("Base"s, nullptr);
+    auto derived = make_class("Derived"s, base.get());
+    runtime::Class inherited{"Inherited"s, {}, base.get()};
+
+    runtime::ClassInstance base_obj{*base};
+    runtime::ClassInstance derived_obj{*derived};
+    runtime::ClassInstance inherited_obj{inherited};
+
+    MethodCall call{make_unique<VariableValue>("obj"s), "GetName"s, {}};
+    runtime::DummyContext context;
+    Closure closure;
+    auto call_on = [&](runtime::ClassInstance& obj) {
+        closure["obj"s] = ObjectHolder::Share(obj);
+        return call.Execute(closure, context).TryAs<runtime::String>()->GetValue();
+    };
+
+    ASSERT_EQUAL(call_on(base_obj), "Base"s);
+    ASSERT_EQUAL(call_on(base_obj), "Base"s);
+    ASSERT_EQUAL(call.GetCache().GetStats().hits, 1U);
+    ASSERT_EQUAL(call.GetCache().GetStats().misses, 1U);
+
+    // Кэш полиморфный: записи для разных классов не вытесняют друг друга
+    ASSERT_EQUAL(call_on(derived_obj), "Derived"s);
+    ASSERT_EQUAL(call_on(inherited_obj), "Base"s);
+    ASSERT_EQUAL(call_on(base_obj), "Base"s);
+    ASSERT_EQUAL(call_on(derived_obj), "Derived"s);
+    ASSERT_EQUAL(call.GetCache().GetStats().hits, 3U);
+    ASSERT_EQUAL(call.GetCache().GetStats().misses, 3U);
+
+    // Когда классов больше, чем записей, вызовы остаются правильными
+    vector<unique_ptr<runtime::Class>> classes;
+    for (size_t i = 0; i < MethodCache::CAPACITY + 2; ++i) {
+        classes.push_back(make_class("C"s + to_string(i), nullptr));
+    }
+    for (int round = 0; round < 2; ++round) {
+        for (const auto& cls : classes) {
+            runtime::ClassInstance obj{*cls};
+            ASSERT_EQUAL(call_on(obj), cls->GetName());
+        }
+    }
+
+    // Неподходящий метод не кэшируется
+    MethodCall bad_call{make_unique<VariableValue>("obj"s), "GetName"s, {}};
+    bad_call.GetArgs().push_back(make_unique<NumericConst>(1));
+    closure["obj"s] = ObjectHolder::Share(base_obj);
+    ASSERT_THROWS(bad_call.Execute(closure, context), runtime_error);
+    ASSERT_THROWS(bad_call.Execute(closure, context), runtime_error);
+    ASSERT_EQUAL(bad_call.GetCache().GetStats().hits, 0U);
+    ASSERT_EQUAL(bad_call.GetCache().GetStats().misses, 2U);
+}
+
 void TestOr() {
     auto test_or = [](bool lhs, bool rhs) {
         Or or_statement{make_unique<BoolConst>(lhs), make_unique<BoolConst>(rhs)};
@@ -518,6 +577,46 @@ void TestNot() {
     test_not(false);
 }
 
+void TestComparison() {
+    auto compare = [](Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs) {
+        Closure closure;
+        runtime::DummyContext context;
+        auto result = MakeComparison(cmp, std::move(lhs), std::move(rhs))->Execute(closure, context);
+        ASSERT(result.TryAs<runtime::Bool>() != nullptr);
+        return result.TryAs<runtime::Bool>()->GetValue();
+    };
+    auto num = [](int value) {
+        return make_unique<NumericConst>(value);
+    };
+    auto str = [](const string& value) {
+        return make_unique<StringConst>(value);
+    };
+
+    ASSERT(compare(Comparator::Less, num(1), num(2)));
+    ASSERT(!compare(Comparator::Greater, num(1), num(2)));
+    ASSERT(compare(Comparator::LessOrEqual, num(2), num(2)));
+    ASSERT(compare(Comparator::GreaterOrEqual, num(2), num(2)));
+    ASSERT(compare(Comparator::Equal, str("abc"s), str("abc"s)));
+    ASSERT(compare(Comparator::NotEqual, str("abc"s), str("abd"s)));
+    ASSERT(compare(Comparator::Greater, str("b"s), str("abc"s)));
+    ASSERT(compare(Comparator::Less, make_unique<BoolConst>(false), make_unique<BoolConst>(true)));
+    ASSERT(compare(Comparator::Equal, make_unique<None>(), make_unique<None>()));
+
+    // Объекты класса сравниваются методами __lt__ и __eq__
+    vector<runtime::Method> methods;
+    methods.push_back({"__lt__"s, {"other"s}, make_unique<BoolConst>(true)});
+    methods.push_back({"__eq__"s, {"other"s}, make_unique<BoolConst>(false)});
+    runtime::Class cls("AlwaysLess"s, std::move(methods), nullptr);
+    ASSERT(compare(Comparator::Less, make_unique<NewInstance>(cls), num(1)));
+    ASSERT(!compare(Comparator::Greater, make_unique<NewInstance>(cls), num(1)));
+    ASSERT(compare(Comparator::LessOrEqual, make_unique<NewInstance>(cls), num(1)));
+    ASSERT(!compare(Comparator::GreaterOrEqual, make_unique<NewInstance>(cls), num(1)));
+    ASSERT(compare(Comparator::NotEqual, make_unique<NewInstance>(cls), num(1)));
+
+    ASSERT_THROWS(compare(Comparator::Less, num(1), str("1"s)), std::runtime_error);
+    ASSERT_THROWS(compare(Comparator::Equal, str("1"s), make_unique<None>()), std::runtime_error);
+}
+
 void TestReturn() {
     Closure closure;
     runtime::DummyContext context;
@@ -526,6 +625,27 @@ void TestReturn() {
     ASSERT(context.output.str().empty());
 }
 
+void TestReturnFromNestedBlocks() {
+    Closure closure;
+    runtime::DummyContext context;
+
+    // return None во вложенном блоке завершает метод так же, как return значения
+    MethodBody body(make_unique<Compound>(
+        make_unique<IfElse>(make_unique<BoolConst>(true),
+                            make_unique<Compound>(make_unique<Compound>(make_unique<Return>(make_unique<None>()))),
+                            nullptr),
+        make_unique<Print>(make_unique<StringConst>("unreachable"s)),
+        make_unique<Return>(make_unique<StringConst>("after"s))));
+    ASSERT(!body.Execute(closure, context));
+    ASSERT(context.output.str().empty());
+
+    MethodBody else_body(make_unique<Compound>(
+        make_unique<IfElse>(make_unique<BoolConst>(false), make_unique<Compound>(),
+                            make_unique<Compound>(make_unique<Return>(make_unique<NumericConst>(7)))),
+        make_unique<Return>(make_unique<NumericConst>(8))));
+    ASSERT_OBJECT_VALUE_EQUAL(else_body.Execute(closure, context), 7);
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
@@ -549,10 +669,13 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestFields);
     RUN_TEST(tr, ast::TestBaseClass);
     RUN_TEST(tr, ast::TestInheritance);
+    RUN_TEST(tr, ast::TestMethodCallCache);
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
     RUN_TEST(tr, ast::TestNot);
+    RUN_TEST(tr, ast::TestComparison);
     RUN_TEST(tr, ast::TestReturn);
+    RUN_TEST(tr, ast::TestReturnFromNestedBlocks);
 }
 
 }  // namespace ast
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "symbol.h"
+
+#include <deque>
+#include <ostream>
+#include <unordered_map>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+// Строки хранятся в deque: при добавлении элементы не перемещаются, поэтому
+// и указатели на строки, и string_view-ключи индекса остаются действительными
+struct SymbolTable {
+    deque<string> names;
+    unordered_map<string_view, const string*> index;
+
+    const string* Intern(string_view name) {
+        if (auto it = index.find(name); it != index.end()) {
+            return it->second;
+        }
+        const string& stored = names.emplace_back(name);
+        index.emplace(stored, &stored);
+        return &stored;
+    }
+};
+
+SymbolTable& GetSymbolTable() {
+    // Таблица не разрушается: символы могут использоваться и при разрушении статических объектов
+    static SymbolTable* table = new SymbolTable();
+    return *table;
+}
+
+const string* GetEmptyName() {
+    static const string* empty = GetSymbolTable().Intern({});
+    return empty;
+}
+
+}  // namespace
+
+Symbol::Symbol()
+    : name_(GetEmptyName()) {
+}
+
+Symbol::Symbol(string_view name)
+    : name_(GetSymbolTable().Intern(name)) {
+}
+
+ostream& operator<<(ostream& os, Symbol symbol) {
+    return os << symbol.Str();
+}
+
+size_t GetSymbolCount() {
+    return GetSymbolTable().names.size();
+}
+
+}  // namespace runtime
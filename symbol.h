@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace runtime {
+
+// Интернированное имя: идентификатор, имя поля или метода.
+// Каждое различное имя хранится в единственном экземпляре в глобальной таблице,
+// а Symbol - указатель на него. Поэтому символ занимает одно машинное слово,
+// а сравнение и хеширование символов - это сравнение и хеширование указателей.
+// Строки таблицы живут до конца работы программы.
+//
+// Таблица не потокобезопасна
+class Symbol {
+public:
+    // Пустое имя
+    Symbol();
+    // Интернирует name. Конструкторы неявные, чтобы символ можно было передать
+    // туда, где раньше ожидалась строка
+    Symbol(std::string_view name);  // NOLINT(google-explicit-constructor)
+    Symbol(const std::string& name)  // NOLINT(google-explicit-constructor)
+        : Symbol(std::string_view{name}) {
+    }
+    Symbol(const char* name)  // NOLINT(google-explicit-constructor)
+        : Symbol(std::string_view{name}) {
+    }
+
+    [[nodiscard]] const std::string& Str() const {
+        return *name_;
+    }
+
+    operator const std::string&() const {  // NOLINT(google-explicit-constructor)
+        return *name_;
+    }
+
+    [[nodiscard]] bool Empty() const {
+        return name_->empty();
+    }
+
+    friend bool operator==(Symbol lhs, Symbol rhs) {
+        return lhs.name_ == rhs.name_;
+    }
+
+    friend bool operator!=(Symbol lhs, Symbol rhs) {
+        return lhs.name_ != rhs.name_;
+    }
+
+private:
+    friend struct std::hash<Symbol>;
+
+    const std::string* name_;
+};
+
+std::ostream& operator<<(std::ostream& os, Symbol symbol);
+
+// Возвращает количество различных интернированных имён
+size_t GetSymbolCount();
+
+}  // namespace runtime
+
+template <>
+struct std::hash<runtime::Symbol> {
+    size_t operator()(runtime::Symbol symbol) const noexcept {
+        return std::hash<const std::string*>{}(symbol.name_);
+    }
+};
@@ -0,0 +1,39 @@
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace parse {
+void RunOpenLexerTests(TestRunner& tr);
+}  // namespace parse
+
+namespace ast {
+void RunUnitTests(TestRunner& tr);
+void RunProgramCacheTests(TestRunner& tr);
+void RunOptimizerTests(TestRunner& tr);
+}  // namespace ast
+namespace runtime {
+void RunObjectHolderTests(TestRunner& tr);
+void RunObjectsTests(TestRunner& tr);
+}  // namespace runtime
+
+namespace vm {
+void RunVmTests(TestRunner& tr);
+}  // namespace vm
+
+void TestParseProgram(TestRunner& tr);
+void RunInterpreterTests(TestRunner& tr);
+
+// Запускает все тесты интерпретатора. При ошибке TestRunner завершает процесс с кодом 1
+int main() {
+    TestRunner tr;
+    parse::RunOpenLexerTests(tr);
+    runtime::RunObjectHolderTests(tr);
+    runtime::RunObjectsTests(tr);
+    ast::RunUnitTests(tr);
+    TestParseProgram(tr);
+    ast::RunProgramCacheTests(tr);
+    ast::RunOptimizerTests(tr);
+    vm::RunVmTests(tr);
+    RunInterpreterTests(tr);
+    return 0;
+}
@@ -0,0 +1,956 @@
+#include "vm.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <sstream>
+
+using namespace std;
+
+#if defined(__GNUC__) || defined(__clang__)
+// GCC и Clang поддерживают адреса меток: переход к обработчику следующей команды
+// выполняется напрямую, без общего switch
+#define MYTHON_VM_COMPUTED_GOTO
+#endif
+
+namespace vm {
+
+using runtime::ClassInstance;
+using runtime::Closure;
+using runtime::Context;
+using runtime::ObjectHolder;
+
+namespace {
+const runtime::Symbol ADD_METHOD{"__add__"};
+const runtime::Symbol INIT_METHOD{"__init__"};
+const runtime::Symbol SUB_METHOD{"__sub__"};
+const runtime::Symbol MUL_METHOD{"__mul__"};
+const runtime::Symbol DIV_METHOD{"__truediv__"};
+const runtime::Symbol SELF{"self"};
+const string NONE = "None"s;
+
+// Находит метод method с arg_count параметрами. Выбрасывает runtime_error, если его нет
+const runtime::Method& FindMethod(const ClassInstance& self, runtime::Symbol method, size_t arg_count) {
+    const runtime::Method* pmethod = self.GetClass().GetMethod(method);
+    if (pmethod == nullptr || pmethod->formal_params.size() != arg_count) {
+        throw std::runtime_error("Method: "s + method.Str() + " does not exist"s);
+    }
+    return *pmethod;
+}
+
+void PrintValue(const ObjectHolder& obj, std::ostream& os, Context& context) {
+    // Встроенные значения печатаются без переноса в кучу
+    if (const int* number = obj.TryAsValue<runtime::Number>()) {
+        runtime::Number(*number).Print(os, context);
+    } else if (const bool* flag = obj.TryAsValue<runtime::Bool>()) {
+        runtime::Bool(*flag).Print(os, context);
+    } else if (obj) {
+        obj->Print(os, context);
+    } else {
+        os << NONE;
+    }
+}
+
+class Compiler {
+public:
+    Compiler(Chunk& chunk, bool global)
+        : chunk_(chunk)
+        , global_(global) {
+    }
+
+    void DeclareLocal(runtime::Symbol name) {
+        if (locals_.count(name) == 0) {
+            locals_[name] = NewRegister();
+            chunk_.local_count = next_register_;
+        }
+    }
+
+    // Объявляет параметр метода или self: значение есть с начала выполнения
+    void DeclareParameter(runtime::Symbol name) {
+        DeclareLocal(name);
+        MarkBound(locals_.at(name));
+    }
+
+    // Заранее выделяет регистры всем локальным переменным тела метода,
+    // чтобы временные регистры выражений не пересекались с ними
+    void CollectLocals(const ast::Statement& statement) {
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            for (const auto& stmt : compound->GetStatements()) {
+                CollectLocals(*stmt);
+            }
+        } else if (const auto* body = dynamic_cast<const ast::MethodBody*>(&statement)) {
+            CollectLocals(body->GetBody());
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            CollectLocals(if_else->GetIfBody());
+            if (if_else->GetElseBody()) {
+                CollectLocals(*if_else->GetElseBody());
+            }
+        } else if (const auto* loop = dynamic_cast<const ast::While*>(&statement)) {
+            CollectLocals(loop->GetBody());
+        } else if (const auto* loop = dynamic_cast<const ast::ForRange*>(&statement)) {
+            DeclareLocal(loop->GetVar());
+            CollectLocals(loop->GetBody());
+        } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+            DeclareLocal(assignment->GetVar());
+        } else if (const auto* definition = dynamic_cast<const ast::ClassDefinition*>(&statement)) {
+            DeclareLocal(definition->GetClass().TryAs<runtime::Class>()->GetName());
+        }
+    }
+
+    // Компилирует инструкции программы по одной. Инструкцию, которую нельзя
+    // перевести в байткод, выполняет обход дерева
+    void CompileTopLevel(runtime::Executable& program) {
+        if (auto* root = dynamic_cast<ast::Program*>(&program)) {
+            CompileTopLevel(*root->GetBody());
+            return;
+        }
+        auto* statement = dynamic_cast<ast::Statement*>(&program);
+        if (statement == nullptr) {
+            chunk_.statements.push_back(&program);
+            Emit(OpCode::Exec, static_cast<uint32_t>(chunk_.statements.size() - 1));
+            return;
+        }
+        auto* compound = dynamic_cast<ast::Compound*>(statement);
+        if (compound == nullptr) {
+            CompileOrExec(*statement);
+            return;
+        }
+        for (const auto& stmt : compound->GetStatements()) {
+            CompileOrExec(*stmt);
+        }
+    }
+
+    void CompileStatement(const ast::Statement& statement) {
+        const uint32_t saved_register = next_register_;
+
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&statement)) {
+            for (const auto& stmt : compound->GetStatements()) {
+                CompileStatement(*stmt);
+            }
+        } else if (const auto* body = dynamic_cast<const ast::MethodBody*>(&statement)) {
+            CompileStatement(body->GetBody());
+        } else if (const auto* tail = dynamic_cast<const ast::TailCall*>(&statement)) {
+            const ast::MethodCall& call = tail->GetCall();
+            const uint32_t object = CompileExpression(call.GetObject());
+            Emit(OpCode::TailCall, object, AddCallSite(call.GetMethod(), nullptr, call.GetArgs()));
+        } else if (const auto* ret = dynamic_cast<const ast::Return*>(&statement)) {
+            Emit(OpCode::Return, CompileExpression(ret->GetStatement()));
+        } else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&statement)) {
+            const uint32_t value = CompileExpression(assignment->GetValue());
+            if (auto local = FindLocal(assignment->GetVar())) {
+                if (*local != value) {
+                    Emit(OpCode::Move, *local, value);
+                }
+                MarkBound(*local);
+            } else if (global_) {
+                Emit(OpCode::StoreGlobal, AddName(assignment->GetVar()), value);
+            } else {
+                throw CompileError("Undeclared local "s + assignment->GetVar().Str());
+            }
+        } else if (const auto* field = dynamic_cast<const ast::FieldAssignment*>(&statement)) {
+            const uint32_t object = CompileExpression(field->GetObject());
+            const uint32_t value = CompileExpression(field->GetValue());
+            Emit(OpCode::StoreField, object, AddName(field->GetFieldName()), value);
+        } else if (const auto* print = dynamic_cast<const ast::Print*>(&statement)) {
+            const auto& args = print->GetArgs();
+            for (size_t i = 0; i < args.size(); ++i) {
+                const uint32_t saved_register = next_register_;
+                Emit(OpCode::Print, CompileExpression(*args[i]), i > 0 ? 1 : 0);
+                next_register_ = saved_register;
+            }
+            Emit(OpCode::PrintLine);
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&statement)) {
+            const uint32_t condition = CompileExpression(if_else->GetCondition());
+            const uint32_t jump_to_else = Emit(OpCode::JumpIfFalse, condition);
+            const vector<bool> bound_before = bound_;
+            CompileStatement(if_else->GetIfBody());
+            vector<bool> bound_after_if = std::move(bound_);
+            bound_ = bound_before;
+            if (const ast::Statement* else_body = if_else->GetElseBody()) {
+                const uint32_t jump_to_end = Emit(OpCode::Jump);
+                Patch(jump_to_else);
+                CompileStatement(*else_body);
+                Patch(jump_to_end);
+            } else {
+                Patch(jump_to_else);
+            }
+            // После if присвоены переменные, присвоенные в обеих ветках
+            for (size_t i = 0; i < bound_.size(); ++i) {
+                bound_[i] = bound_[i] && i < bound_after_if.size() && bound_after_if[i];
+            }
+        } else if (const auto* loop = dynamic_cast<const ast::While*>(&statement)) {
+            const auto start = static_cast<uint32_t>(chunk_.code.size());
+            const vector<bool> bound_before = bound_;
+            const uint32_t condition = CompileExpression(loop->GetCondition());
+            const uint32_t jump_to_end = Emit(OpCode::JumpIfFalse, condition);
+            loops_.emplace_back();
+            CompileStatement(loop->GetBody());
+            Emit(OpCode::Jump, start);
+            Patch(jump_to_end);
+            FinishLoop(start);
+            // Тело могло не выполниться ни разу
+            bound_ = bound_before;
+        } else if (const auto* loop = dynamic_cast<const ast::ForRange*>(&statement)) {
+            CompileForRange(*loop);
+        } else if (dynamic_cast<const ast::Break*>(&statement) != nullptr) {
+            if (loops_.empty()) {
+                throw CompileError("'break' outside loop"s);
+            }
+            loops_.back().breaks.push_back(Emit(OpCode::Jump));
+        } else if (dynamic_cast<const ast::Continue*>(&statement) != nullptr) {
+            if (loops_.empty()) {
+                throw CompileError("'continue' outside loop"s);
+            }
+            loops_.back().continues.push_back(Emit(OpCode::Jump));
+        } else if (const auto* definition = dynamic_cast<const ast::ClassDefinition*>(&statement)) {
+            const ObjectHolder& cls = definition->GetClass();
+            const string& name = cls.TryAs<runtime::Class>()->GetName();
+            const uint32_t constant = AddConstant(cls);
+            if (auto local = FindLocal(name)) {
+                Emit(OpCode::LoadConst, *local, constant);
+                MarkBound(*local);
+            } else {
+                const uint32_t reg = NewRegister();
+                Emit(OpCode::LoadConst, reg, constant);
+                Emit(OpCode::StoreGlobal, AddName(name), reg);
+            }
+        } else {
+            CompileExpression(statement);
+        }
+
+        next_register_ = saved_register;
+    }
+
+    // Возвращает регистр, в котором будет лежать значение выражения
+    uint32_t CompileExpression(const ast::Statement& expression) {
+        if (const auto* var = dynamic_cast<const ast::VariableValue*>(&expression)) {
+            if (var->GetDottedIds().size() == 1) {
+                if (auto local = FindLocal(var->GetDottedIds()[0])) {
+                    return ReadLocal(*local, var->GetDottedIds()[0]);
+                }
+            }
+        }
+        const uint32_t dst = NewRegister();
+        CompileInto(expression, dst);
+        return dst;
+    }
+
+private:
+    // Переходы break и continue, которые направляются после компиляции тела цикла
+    struct LoopJumps {
+        vector<uint32_t> breaks;
+        vector<uint32_t> continues;
+    };
+
+    void CompileOrExec(ast::Statement& statement) {
+        const size_t code_size = chunk_.code.size();
+        const uint32_t saved_register = next_register_;
+        const size_t loop_count = loops_.size();
+        try {
+            CompileStatement(statement);
+        } catch (const CompileError&) {
+            chunk_.code.resize(code_size);
+            next_register_ = saved_register;
+            loops_.resize(loop_count);
+            chunk_.statements.push_back(&statement);
+            Emit(OpCode::Exec, static_cast<uint32_t>(chunk_.statements.size() - 1));
+        }
+    }
+
+    void CompileInto(const ast::Statement& expression, uint32_t dst) {
+        if (const auto* num = dynamic_cast<const ast::NumericConst*>(&expression)) {
+            Emit(OpCode::LoadConst, dst, AddConstant(ObjectHolder::Own(runtime::Number{num->GetValue()})));
+        } else if (const auto* str = dynamic_cast<const ast::StringConst*>(&expression)) {
+            Emit(OpCode::LoadConst, dst, AddConstant(ObjectHolder::Own(runtime::String{str->GetValue()})));
+        } else if (const auto* b = dynamic_cast<const ast::BoolConst*>(&expression)) {
+            Emit(OpCode::LoadConst, dst, AddConstant(ObjectHolder::Own(runtime::Bool{b->GetValue()})));
+        } else if (dynamic_cast<const ast::None*>(&expression)) {
+            Emit(OpCode::LoadNone, dst);
+        } else if (const auto* var = dynamic_cast<const ast::VariableValue*>(&expression)) {
+            CompileVariable(*var, dst);
+        } else if (const auto* add = dynamic_cast<const ast::Add*>(&expression)) {
+            CompileBinary(OpCode::Add, *add, dst);
+        } else if (const auto* sub = dynamic_cast<const ast::Sub*>(&expression)) {
+            CompileBinary(OpCode::Sub, *sub, dst);
+        } else if (const auto* mult = dynamic_cast<const ast::Mult*>(&expression)) {
+            CompileBinary(OpCode::Mul, *mult, dst);
+        } else if (const auto* div = dynamic_cast<const ast::Div*>(&expression)) {
+            CompileBinary(OpCode::Div, *div, dst);
+        } else if (const auto* cmp = dynamic_cast<const ast::Comparison*>(&expression)) {
+            CompileBinary(ComparisonOpCode(*cmp), *cmp, dst);
+        } else if (const auto* op_or = dynamic_cast<const ast::Or*>(&expression)) {
+            CompileShortCircuit(*op_or, true, dst);
+        } else if (const auto* op_and = dynamic_cast<const ast::And*>(&expression)) {
+            CompileShortCircuit(*op_and, false, dst);
+        } else if (const auto* op_not = dynamic_cast<const ast::Not*>(&expression)) {
+            Emit(OpCode::Not, dst, CompileExpression(op_not->GetArgument()));
+        } else if (const auto* negate = dynamic_cast<const ast::Negate*>(&expression)) {
+            Emit(OpCode::Negate, dst, CompileExpression(negate->GetArgument()));
+        } else if (const auto* stringify = dynamic_cast<const ast::Stringify*>(&expression)) {
+            Emit(OpCode::Stringify, dst, CompileExpression(stringify->GetArgument()));
+        } else if (const auto* call = dynamic_cast<const ast::MethodCall*>(&expression)) {
+            const uint32_t object = CompileExpression(call->GetObject());
+            const uint32_t site = AddCallSite(call->GetMethod(), nullptr, call->GetArgs());
+            Emit(OpCode::CallMethod, dst, object, site);
+        } else if (const auto* instance = dynamic_cast<const ast::NewInstance*>(&expression)) {
+            const uint32_t site = AddCallSite(INIT_METHOD, &instance->GetClass(), instance->GetArgs());
+            Emit(OpCode::NewInstance, dst, site);
+        } else {
+            throw CompileError("Unsupported statement"s);
+        }
+    }
+
+    // Счётчик, граница и шаг лежат в регистрах, которые не видны программе,
+    // поэтому присваивание переменной цикла в теле не меняет число итераций
+    void CompileForRange(const ast::ForRange& loop) {
+        const uint32_t counter = NewRegister();
+        NewRegister();
+        NewRegister();
+        CompileInto(loop.GetStart(), counter);
+        CompileInto(loop.GetStop(), counter + 1);
+        CompileInto(loop.GetStep(), counter + 2);
+        const uint32_t prepare = Emit(OpCode::ForPrepare, counter);
+
+        const vector<bool> bound_before = bound_;
+        const auto body_start = static_cast<uint32_t>(chunk_.code.size());
+        if (auto local = FindLocal(loop.GetVar())) {
+            Emit(OpCode::Move, *local, counter);
+            MarkBound(*local);
+        } else if (global_) {
+            Emit(OpCode::StoreGlobal, AddName(loop.GetVar()), counter);
+        } else {
+            throw CompileError("Undeclared local "s + loop.GetVar().Str());
+        }
+        loops_.emplace_back();
+        CompileStatement(loop.GetBody());
+
+        const auto step = static_cast<uint32_t>(chunk_.code.size());
+        Emit(OpCode::ForStep, counter, body_start);
+        Patch(prepare);
+        FinishLoop(step);
+        bound_ = bound_before;
+    }
+
+    // Направляет break текущего цикла на следующую команду, а continue - на адрес continue_target
+    void FinishLoop(uint32_t continue_target) {
+        for (uint32_t jump : loops_.back().breaks) {
+            Patch(jump);
+        }
+        for (uint32_t jump : loops_.back().continues) {
+            chunk_.code[jump].a = continue_target;
+        }
+        loops_.pop_back();
+    }
+
+    void CompileVariable(const ast::VariableValue& var, uint32_t dst) {
+        const auto& ids = var.GetDottedIds();
+        if (auto local = FindLocal(ids[0])) {
+            Emit(OpCode::Move, dst, ReadLocal(*local, ids[0]));
+        } else {
+            Emit(OpCode::LoadGlobal, dst, AddName(ids[0]));
+        }
+        for (size_t i = 1; i < ids.size(); ++i) {
+            Emit(OpCode::LoadField, dst, dst, AddName(ids[i]));
+        }
+    }
+
+    void CompileBinary(OpCode op, const ast::BinaryOperation& operation, uint32_t dst) {
+        const uint32_t lhs = CompileExpression(operation.GetLhs());
+        const uint32_t rhs = CompileExpression(operation.GetRhs());
+        Emit(op, dst, lhs, rhs);
+    }
+
+    void CompileShortCircuit(const ast::BinaryOperation& operation, bool short_val, uint32_t dst) {
+        CompileInto(operation.GetLhs(), dst);
+        const uint32_t jump = Emit(OpCode::ShortCircuit, dst, 0, short_val ? 1 : 0);
+        // Правый операнд вычисляется не всегда, и проверки в нём не считаются
+        const vector<bool> bound_before = bound_;
+        CompileInto(operation.GetRhs(), dst);
+        bound_ = bound_before;
+        Emit(OpCode::CheckBool, dst);
+        chunk_.code[jump].b = static_cast<uint32_t>(chunk_.code.size());
+    }
+
+    static OpCode ComparisonOpCode(const ast::Comparison& comparison) {
+        switch (comparison.GetComparator()) {
+            case ast::Comparator::Equal:
+                return OpCode::Equal;
+            case ast::Comparator::NotEqual:
+                return OpCode::NotEqual;
+            case ast::Comparator::Less:
+                return OpCode::Less;
+            case ast::Comparator::Greater:
+                return OpCode::Greater;
+            case ast::Comparator::LessOrEqual:
+                return OpCode::LessOrEqual;
+            case ast::Comparator::GreaterOrEqual:
+                return OpCode::GreaterOrEqual;
+        }
+        throw CompileError("Unsupported comparator"s);
+    }
+
+    // Размещает значения аргументов в подряд идущих регистрах и возвращает первый из них
+    uint32_t CompileArguments(const vector<unique_ptr<ast::Statement>>& args) {
+        const uint32_t first = next_register_;
+        for (size_t i = 0; i < args.size(); ++i) {
+            NewRegister();
+        }
+        for (size_t i = 0; i < args.size(); ++i) {
+            CompileInto(*args[i], first + static_cast<uint32_t>(i));
+        }
+        return first;
+    }
+
+    uint32_t AddCallSite(runtime::Symbol method, const runtime::Class* cls,
+                         const vector<unique_ptr<ast::Statement>>& args) {
+        CallSite site;
+        site.method = method;
+        site.cls = cls;
+        site.first_arg = CompileArguments(args);
+        site.arg_count = static_cast<uint32_t>(args.size());
+        chunk_.calls.push_back(std::move(site));
+        return static_cast<uint32_t>(chunk_.calls.size() - 1);
+    }
+
+    // Возвращает регистр локальной переменной name для чтения. Если переменной
+    // к этому месту могло быть ничего не присвоено, добавляет проверку CheckBound
+    uint32_t ReadLocal(uint32_t reg, runtime::Symbol name) {
+        if (reg >= bound_.size() || !bound_[reg]) {
+            Emit(OpCode::CheckBound, reg, AddName(name));
+            MarkBound(reg);
+        }
+        return reg;
+    }
+
+    void MarkBound(uint32_t reg) {
+        if (reg >= bound_.size()) {
+            bound_.resize(reg + 1);
+        }
+        bound_[reg] = true;
+    }
+
+    optional<uint32_t> FindLocal(runtime::Symbol name) const {
+        if (auto it = locals_.find(name); it != locals_.end()) {
+            return it->second;
+        }
+        return nullopt;
+    }
+
+    uint32_t NewRegister() {
+        const uint32_t reg = next_register_++;
+        chunk_.register_count = max(chunk_.register_count, next_register_);
+        return reg;
+    }
+
+    uint32_t Emit(OpCode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+        chunk_.code.push_back({op, a, b, c});
+        return static_cast<uint32_t>(chunk_.code.size() - 1);
+    }
+
+    // Направляет переход, записанный по адресу jump, на следующую команду
+    void Patch(uint32_t jump) {
+        Instruction& instruction = chunk_.code[jump];
+        const auto target = static_cast<uint32_t>(chunk_.code.size());
+        if (instruction.op == OpCode::Jump) {
+            instruction.a = target;
+        } else {
+            instruction.b = target;
+        }
+    }
+
+    uint32_t AddConstant(ObjectHolder value) {
+        chunk_.constants.push_back(std::move(value));
+        return static_cast<uint32_t>(chunk_.constants.size() - 1);
+    }
+
+    uint32_t AddName(runtime::Symbol name) {
+        auto [it, inserted] = names_.emplace(name, static_cast<uint32_t>(chunk_.names.size()));
+        if (inserted) {
+            chunk_.names.push_back(name);
+            chunk_.field_caches.emplace_back();
+        }
+        return it->second;
+    }
+
+    Chunk& chunk_;
+    bool global_;
+    uint32_t next_register_ = 0;
+    unordered_map<runtime::Symbol, uint32_t> locals_;
+    // Регистры локальных переменных, которым на всех путях к компилируемой команде
+    // уже присвоено значение
+    vector<bool> bound_;
+    unordered_map<runtime::Symbol, uint32_t> names_;
+    // Циклы, внутри которых находится компилируемая инструкция
+    vector<LoopJumps> loops_;
+};
+
+}  // namespace
+
+unique_ptr<Chunk> CompileProgram(runtime::Executable& program) {
+    auto chunk = make_unique<Chunk>();
+    Compiler compiler(*chunk, true);
+    compiler.CompileTopLevel(program);
+    chunk->code.push_back({OpCode::ReturnNone});
+    return chunk;
+}
+
+unique_ptr<Chunk> CompileMethod(const runtime::Method& method) {
+    const auto* body = dynamic_cast<const ast::Statement*>(method.body.get());
+    if (body == nullptr) {
+        throw CompileError("Method body is not an AST node"s);
+    }
+    auto chunk = make_unique<Chunk>();
+    Compiler compiler(*chunk, false);
+    for (runtime::Symbol param : method.formal_params) {
+        compiler.DeclareParameter(param);
+    }
+    compiler.DeclareParameter(SELF);
+    compiler.CollectLocals(*body);
+    compiler.CompileStatement(*body);
+    chunk->code.push_back({OpCode::ReturnNone});
+    return chunk;
+}
+
+ObjectHolder Machine::Run(const Chunk& chunk, Closure& closure, Context& context) {
+    // Регистры программы не занимают кадр стека: глубина считается только по вызовам методов
+    vector<ObjectHolder> registers(chunk.register_count);
+    return Execute(chunk, registers.data(), &closure, context);
+}
+
+const Chunk* Machine::GetMethodChunk(const runtime::Method& method) {
+    auto it = methods_.find(&method);
+    if (it == methods_.end()) {
+        unique_ptr<Chunk> chunk;
+        try {
+            chunk = CompileMethod(method);
+        } catch (const CompileError&) {
+        }
+        it = methods_.emplace(&method, std::move(chunk)).first;
+    }
+    return it->second.get();
+}
+
+ObjectHolder Machine::Invoke(ClassInstance& self, runtime::Symbol method,
+                             vector<ObjectHolder> actual_args, Context& context) {
+    const runtime::Method& called = FindMethod(self, method, actual_args.size());
+    const Chunk* chunk = GetMethodChunk(called);
+    if (chunk == nullptr) {
+        return self.Call(called, actual_args, context);
+    }
+    const runtime::CallStack::Frame frame(chunk->register_count);
+    ObjectHolder* registers = frame.Slots();
+    std::move(actual_args.begin(), actual_args.end(), registers);
+    registers[actual_args.size()] = ObjectHolder::Share(self);
+    std::fill(registers + actual_args.size() + 1, registers + chunk->local_count, ObjectHolder::Unbound());
+    return Execute(*chunk, registers, nullptr, context);
+}
+
+ObjectHolder Machine::Execute(const Chunk& entry, ObjectHolder* regs, Closure* globals,
+                              Context& context) {
+    const Chunk* chunk = &entry;
+    const Instruction* code = chunk->code.data();
+    const Instruction* ip = code;
+    const Instruction* ins = nullptr;
+
+    // Кадры, начатые этим вызовом Execute, освобождаются и при выходе по исключению
+    auto& stack = runtime::CallStack::Get();
+    const size_t base = calls_.size();
+    struct Unwinder {
+        vector<CallRecord>& calls;
+        runtime::CallStack& stack;
+        size_t base;
+        ~Unwinder() {
+            for (; calls.size() > base; calls.pop_back()) {
+                stack.Pop();
+            }
+        }
+    } unwinder{calls_, stack, base};
+
+    // Начинает выполнять callee в новом кадре. Аргументы копируются из регистров
+    // точки вызова site, self - из регистра self_reg
+    auto enter = [&](const Chunk& callee, const CallSite& site, uint32_t self_reg, uint32_t result,
+                     ResultUse use) {
+        ObjectHolder* frame = stack.Push(callee.register_count);
+        calls_.push_back({chunk, ip, regs, globals, result, use});
+        std::copy(regs + site.first_arg, regs + site.first_arg + site.arg_count, frame);
+        frame[site.arg_count] = regs[self_reg];
+        std::fill(frame + site.arg_count + 1, frame + callee.local_count, ObjectHolder::Unbound());
+        chunk = &callee;
+        code = ip = callee.code.data();
+        regs = frame;
+        globals = nullptr;
+    };
+
+    // Возвращает value в ожидающий кадр. Возвращает true, если ожидающих кадров
+    // этого вызова Execute не осталось и value надо вернуть из Execute
+    auto leave = [&](ObjectHolder& value) {
+        for (;;) {
+            if (calls_.size() == base) {
+                return true;
+            }
+            stack.Pop();
+            const CallRecord caller = calls_.back();
+            calls_.pop_back();
+            chunk = caller.chunk;
+            code = chunk->code.data();
+            ip = caller.ip;
+            regs = caller.regs;
+            globals = caller.globals;
+            if (caller.use == ResultUse::Store) {
+                regs[caller.result] = std::move(value);
+            }
+            if (caller.use != ResultUse::Return) {
+                return false;
+            }
+        }
+    };
+
+    auto arithmetic_fallback = [this, &context](runtime::Symbol method, const ObjectHolder& lhs,
+                                                const ObjectHolder& rhs, const char* error) {
+        if (ClassInstance* instance = lhs.TryAs<ClassInstance>()) {
+            if (instance->HasMethod(method, 1)) {
+                return Invoke(*instance, method, {rhs}, context);
+            }
+        }
+        throw std::runtime_error(error);
+    };
+
+#ifdef MYTHON_VM_COMPUTED_GOTO
+#define MYTHON_VM_LABEL_ADDRESS(name) &&op_##name,
+    static const void* const dispatch_table[] = {MYTHON_VM_OPCODES(MYTHON_VM_LABEL_ADDRESS)};
+#undef MYTHON_VM_LABEL_ADDRESS
+#define VM_CASE(name) op_##name:
+#define VM_DISPATCH()                                          \
+    do {                                                       \
+        ins = ip++;                                            \
+        goto* dispatch_table[static_cast<size_t>(ins->op)];    \
+    } while (false)
+
+    VM_DISPATCH();
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_DISPATCH() continue
+
+    for (;;) {
+        ins = ip++;
+        switch (ins->op) {
+#endif
+
+    VM_CASE(LoadConst) {
+        regs[ins->a] = chunk->constants[ins->b];
+        VM_DISPATCH();
+    }
+    VM_CASE(LoadNone) {
+        regs[ins->a] = ObjectHolder::None();
+        VM_DISPATCH();
+    }
+    VM_CASE(Move) {
+        regs[ins->a] = regs[ins->b];
+        VM_DISPATCH();
+    }
+    VM_CASE(CheckBound) {
+        if (regs[ins->a].IsUnbound()) {
+            throw std::runtime_error("Unknown fild " + chunk->names[ins->b].Str());
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(LoadGlobal) {
+        const runtime::Symbol name = chunk->names[ins->b];
+        if (globals == nullptr) {
+            throw std::runtime_error("Unknown fild " + name.Str());
+        }
+        const ObjectHolder* value = globals->Find(name, chunk->field_caches[ins->b]);
+        if (value == nullptr) {
+            throw std::runtime_error("Unknown fild " + name.Str());
+        }
+        regs[ins->a] = *value;
+        VM_DISPATCH();
+    }
+    VM_CASE(StoreGlobal) {
+        globals->Emplace(chunk->names[ins->a], chunk->field_caches[ins->a]) = regs[ins->b];
+        VM_DISPATCH();
+    }
+    VM_CASE(LoadField) {
+        const runtime::Symbol name = chunk->names[ins->c];
+        ClassInstance* instance = regs[ins->b].TryAs<ClassInstance>();
+        if (instance == nullptr) {
+            throw std::runtime_error("Unknown fild " + name.Str());
+        }
+        const ObjectHolder* value = instance->Fields().Find(name, chunk->field_caches[ins->c]);
+        if (value == nullptr) {
+            throw std::runtime_error("Unknown fild " + name.Str());
+        }
+        regs[ins->a] = *value;
+        VM_DISPATCH();
+    }
+    VM_CASE(StoreField) {
+        ClassInstance* instance = regs[ins->a].TryAs<ClassInstance>();
+        if (instance == nullptr) {
+            throw std::runtime_error("Field assignment for not class type");
+        }
+        instance->Fields().Emplace(chunk->names[ins->b], chunk->field_caches[ins->b]) = regs[ins->c];
+        VM_DISPATCH();
+    }
+    VM_CASE(Add) {
+        const ObjectHolder& lhs = regs[ins->b];
+        const ObjectHolder& rhs = regs[ins->c];
+        if (const int* lnum = lhs.TryAsValue<runtime::Number>()) {
+            if (const int* rnum = rhs.TryAsValue<runtime::Number>()) {
+                regs[ins->a] = ObjectHolder::Own(runtime::Number{*lnum + *rnum});
+                VM_DISPATCH();
+            }
+        } else if (auto* lstr = lhs.TryAs<runtime::String>()) {
+            if (auto* rstr = rhs.TryAs<runtime::String>()) {
+                regs[ins->a] = ObjectHolder::Own(runtime::String{lstr->GetValue() + rstr->GetValue()});
+                VM_DISPATCH();
+            }
+        }
+        regs[ins->a] = arithmetic_fallback(ADD_METHOD, lhs, rhs, "Adding with diferent types");
+        VM_DISPATCH();
+    }
+    VM_CASE(Sub) {
+        const ObjectHolder& lhs = regs[ins->b];
+        const ObjectHolder& rhs = regs[ins->c];
+        if (const int* lnum = lhs.TryAsValue<runtime::Number>()) {
+            if (const int* rnum = rhs.TryAsValue<runtime::Number>()) {
+                regs[ins->a] = ObjectHolder::Own(runtime::Number{*lnum - *rnum});
+                VM_DISPATCH();
+            }
+        }
+        regs[ins->a] = arithmetic_fallback(SUB_METHOD, lhs, rhs, "Sub with diferent types");
+        VM_DISPATCH();
+    }
+    VM_CASE(Mul) {
+        const ObjectHolder& lhs = regs[ins->b];
+        const ObjectHolder& rhs = regs[ins->c];
+        if (const int* lnum = lhs.TryAsValue<runtime::Number>()) {
+            if (const int* rnum = rhs.TryAsValue<runtime::Number>()) {
+                regs[ins->a] = ObjectHolder::Own(runtime::Number{*lnum * *rnum});
+                VM_DISPATCH();
+            }
+        }
+        regs[ins->a] = arithmetic_fallback(MUL_METHOD, lhs, rhs, "Mult with diferent types");
+        VM_DISPATCH();
+    }
+    VM_CASE(Div) {
+        const ObjectHolder& lhs = regs[ins->b];
+        const ObjectHolder& rhs = regs[ins->c];
+        if (const int* lnum = lhs.TryAsValue<runtime::Number>()) {
+            if (const int* rnum = rhs.TryAsValue<runtime::Number>()) {
+                if (*rnum == 0) {
+                    throw std::runtime_error("Div0");
+                }
+                regs[ins->a] = ObjectHolder::Own(runtime::Number{*lnum / *rnum});
+                VM_DISPATCH();
+            }
+        }
+        regs[ins->a] = arithmetic_fallback(DIV_METHOD, lhs, rhs, "Div with diferent types");
+        VM_DISPATCH();
+    }
+
+#define MYTHON_VM_COMPARISON(name)                                                          \
+    VM_CASE(name) {                                                                         \
+        const bool result = ast::ComparisonOperation<ast::Comparator::name>::Compare(        \
+            regs[ins->b], regs[ins->c], context);                                           \
+        regs[ins->a] = ObjectHolder::Own(runtime::Bool{result});                            \
+        VM_DISPATCH();                                                                      \
+    }
+    MYTHON_VM_COMPARISON(Equal)
+    MYTHON_VM_COMPARISON(NotEqual)
+    MYTHON_VM_COMPARISON(Less)
+    MYTHON_VM_COMPARISON(Greater)
+    MYTHON_VM_COMPARISON(LessOrEqual)
+    MYTHON_VM_COMPARISON(GreaterOrEqual)
+#undef MYTHON_VM_COMPARISON
+
+    VM_CASE(Not) {
+        if (const bool* b = regs[ins->b].TryAsValue<runtime::Bool>()) {
+            regs[ins->a] = ObjectHolder::Own(runtime::Bool{!*b});
+            VM_DISPATCH();
+        }
+        throw std::runtime_error("not for not bool val");
+    }
+    VM_CASE(Negate) {
+        if (const int* num = regs[ins->b].TryAsValue<runtime::Number>()) {
+            regs[ins->a] = ObjectHolder::Own(runtime::Number{-*num});
+            VM_DISPATCH();
+        }
+        regs[ins->a] = arithmetic_fallback(MUL_METHOD, regs[ins->b], ObjectHolder::Own(runtime::Number{-1}),
+                                           "Mult with diferent types");
+        VM_DISPATCH();
+    }
+    VM_CASE(ShortCircuit) {
+        const bool* b = regs[ins->a].TryAsValue<runtime::Bool>();
+        if (b == nullptr) {
+            throw std::runtime_error("bool operator for not bool vals");
+        }
+        if (*b == (ins->c != 0)) {
+            ip = code + ins->b;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(CheckBool) {
+        if (regs[ins->a].TryAsValue<runtime::Bool>() == nullptr) {
+            throw std::runtime_error("bool operator for not bool vals");
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(Stringify) {
+        std::ostringstream os;
+        runtime::SimpleContext simple_context(os);
+        PrintValue(regs[ins->b], os, simple_context);
+        regs[ins->a] = ObjectHolder::Own(runtime::String{os.str()});
+        VM_DISPATCH();
+    }
+    VM_CASE(Jump) {
+        ip = code + ins->a;
+        VM_DISPATCH();
+    }
+    VM_CASE(JumpIfFalse) {
+        if (!runtime::IsTrue(regs[ins->a])) {
+            ip = code + ins->b;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(ForPrepare) {
+        const int* start = regs[ins->a].TryAsValue<runtime::Number>();
+        const int* stop = regs[ins->a + 1].TryAsValue<runtime::Number>();
+        const int* step = regs[ins->a + 2].TryAsValue<runtime::Number>();
+        if (start == nullptr || stop == nullptr || step == nullptr) {
+            throw std::runtime_error("range() arguments must be numbers");
+        }
+        if (*step == 0) {
+            throw std::runtime_error("range() step must not be zero");
+        }
+        if (*step > 0 ? *start >= *stop : *start <= *stop) {
+            ip = code + ins->b;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(ForStep) {
+        // Типы и шаг проверены в ForPrepare. Сумма считается шире int, чтобы не переполниться
+        const int step = *regs[ins->a + 2].TryAsValue<runtime::Number>();
+        const int stop = *regs[ins->a + 1].TryAsValue<runtime::Number>();
+        const int64_t next = int64_t{*regs[ins->a].TryAsValue<runtime::Number>()} + step;
+        if (step > 0 ? next < stop : next > stop) {
+            regs[ins->a] = ObjectHolder::Own(runtime::Number{static_cast<int>(next)});
+            ip = code + ins->b;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(Print) {
+        std::ostream& os = context.GetOutputStream();
+        if (ins->b != 0) {
+            os << ' ';
+        }
+        PrintValue(regs[ins->a], os, context);
+        VM_DISPATCH();
+    }
+    VM_CASE(PrintLine) {
+        context.GetOutputStream() << '\n';
+        VM_DISPATCH();
+    }
+    VM_CASE(CallMethod) {
+        ClassInstance* instance = regs[ins->b].TryAs<ClassInstance>();
+        if (instance == nullptr) {
+            throw std::runtime_error("Call method for not class type");
+        }
+        const CallSite& site = chunk->calls[ins->c];
+        const runtime::Method& method = FindMethod(*instance, site.method, site.arg_count);
+        if (const Chunk* callee = GetMethodChunk(method)) {
+            enter(*callee, site, ins->b, ins->a, ResultUse::Store);
+        } else {
+            vector<ObjectHolder> args(regs + site.first_arg, regs + site.first_arg + site.arg_count);
+            regs[ins->a] = instance->Call(method, args, context);
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(TailCall) {
+        ClassInstance* instance = regs[ins->a].TryAs<ClassInstance>();
+        if (instance == nullptr) {
+            throw std::runtime_error("Call method for not class type");
+        }
+        const CallSite& site = chunk->calls[ins->b];
+        const runtime::Method& method = FindMethod(*instance, site.method, site.arg_count);
+        const Chunk* callee = GetMethodChunk(method);
+        if (callee == nullptr) {
+            vector<ObjectHolder> args(regs + site.first_arg, regs + site.first_arg + site.arg_count);
+            ObjectHolder value = instance->Call(method, args, context);
+            if (leave(value)) {
+                return value;
+            }
+            VM_DISPATCH();
+        }
+        if (callee != chunk) {
+            enter(*callee, site, ins->a, 0, ResultUse::Return);
+            VM_DISPATCH();
+        }
+        // Регистры аргументов лежат за локальными переменными, поэтому перенос
+        // в регистры параметров ничего не затирает
+        ObjectHolder self = std::move(regs[ins->a]);
+        for (uint32_t i = 0; i < site.arg_count; ++i) {
+            regs[i] = std::move(regs[site.first_arg + i]);
+        }
+        regs[site.arg_count] = std::move(self);
+        for (uint32_t i = site.arg_count + 1; i < chunk->register_count; ++i) {
+            regs[i] = i < chunk->local_count ? ObjectHolder::Unbound() : ObjectHolder();
+        }
+        ip = code;
+        VM_DISPATCH();
+    }
+    VM_CASE(NewInstance) {
+        const CallSite& site = chunk->calls[ins->b];
+        ObjectHolder instance = ObjectHolder::Own(ClassInstance{*site.cls});
+        const runtime::Method* init = site.cls->GetMethod(INIT_METHOD);
+        const size_t params = (init == nullptr) ? 0 : init->formal_params.size();
+        if (params != site.arg_count) {
+            throw std::runtime_error("Can't find constructor for " + site.cls->GetName());
+        }
+        regs[ins->a] = std::move(instance);
+        if (init != nullptr) {
+            if (const Chunk* callee = GetMethodChunk(*init)) {
+                enter(*callee, site, ins->a, 0, ResultUse::Discard);
+            } else {
+                vector<ObjectHolder> args(regs + site.first_arg, regs + site.first_arg + site.arg_count);
+                regs[ins->a].TryAs<ClassInstance>()->Call(*init, args, context);
+            }
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(Exec) {
+        assert(globals != nullptr);
+        chunk->statements[ins->a]->Execute(*globals, context);
+        VM_DISPATCH();
+    }
+    VM_CASE(Return) {
+        ObjectHolder value = regs[ins->a];
+        if (leave(value)) {
+            return value;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(ReturnNone) {
+        ObjectHolder value = ObjectHolder::None();
+        if (leave(value)) {
+            return value;
+        }
+        VM_DISPATCH();
+    }
+
+#ifndef MYTHON_VM_COMPUTED_GOTO
+        }
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_DISPATCH
+}
+
+void RunProgram(runtime::Executable& program, Closure& closure, Context& context) {
+    Machine machine;
+    machine.Run(*CompileProgram(program), closure, context);
+}
+
+}  // namespace vm
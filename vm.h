@@ -0,0 +1,165 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vm {
+
+// Список команд виртуальной машины. Порядок задаёт и перечисление OpCode,
+// и таблицу переходов шитого кода в vm.cpp
+#define MYTHON_VM_OPCODES(X) \
+    X(LoadConst)             \
+    X(LoadNone)              \
+    X(Move)                  \
+    X(CheckBound)            \
+    X(LoadGlobal)            \
+    X(StoreGlobal)           \
+    X(LoadField)             \
+    X(StoreField)            \
+    X(Add)                   \
+    X(Sub)                   \
+    X(Mul)                   \
+    X(Div)                   \
+    X(Equal)                 \
+    X(NotEqual)              \
+    X(Less)                  \
+    X(Greater)               \
+    X(LessOrEqual)           \
+    X(GreaterOrEqual)        \
+    X(Not)                   \
+    X(Negate)                \
+    X(ShortCircuit)          \
+    X(CheckBool)             \
+    X(Stringify)             \
+    X(Jump)                  \
+    X(JumpIfFalse)           \
+    X(ForPrepare)            \
+    X(ForStep)               \
+    X(Print)                 \
+    X(PrintLine)             \
+    X(CallMethod)            \
+    X(TailCall)              \
+    X(NewInstance)           \
+    X(Exec)                  \
+    X(Return)                \
+    X(ReturnNone)
+
+enum class OpCode : std::uint8_t {
+#define MYTHON_VM_ENUM_ITEM(name) name,
+    MYTHON_VM_OPCODES(MYTHON_VM_ENUM_ITEM)
+#undef MYTHON_VM_ENUM_ITEM
+};
+
+// Трёхадресная команда: a, b, c - номера регистров, констант, имён или адреса переходов.
+// Цикл for занимает три подряд идущих регистра a, a + 1, a + 2: счётчик, границу и шаг.
+// ForPrepare проверяет их и переходит по адресу b, если цикл пуст, ForStep увеличивает
+// счётчик на шаг и переходит по адресу b, если счётчик не вышел за границу.
+// TailCall вызывает у объекта из регистра a метод точки вызова b и возвращает результат;
+// если это метод самого кода, регистры переиспользуются, и выполнение начинается сначала.
+// Print выводит значение регистра a, перед ним пробел, если b != 0; PrintLine завершает строку.
+// Каждый аргумент print выводится сразу после вычисления, как при обходе дерева.
+// CheckBound выбрасывает ошибку, если локальной переменной в регистре a с именем b
+// ещё ничего не присвоено. Компилятор ставит её только там, где это возможно
+struct Instruction {
+    OpCode op;
+    std::uint32_t a = 0;
+    std::uint32_t b = 0;
+    std::uint32_t c = 0;
+};
+
+// Описание точки вызова метода или конструктора.
+// Аргументы лежат в регистрах [first_arg, first_arg + arg_count)
+struct CallSite {
+    runtime::Symbol method;
+    const runtime::Class* cls = nullptr;
+    std::uint32_t first_arg = 0;
+    std::uint32_t arg_count = 0;
+};
+
+// Скомпилированная единица кода: тело программы либо тело метода
+struct Chunk {
+    std::vector<Instruction> code;
+    std::vector<runtime::ObjectHolder> constants;
+    std::vector<runtime::Symbol> names;
+    // Кэши доступа к переменным и полям, по одному на каждое имя из names
+    mutable std::vector<runtime::FieldCache> field_caches;
+    std::vector<CallSite> calls;
+    // Инструкции, которые выполняются обходом дерева (команда Exec)
+    std::vector<runtime::Executable*> statements;
+    std::uint32_t register_count = 0;
+    // Регистры [0, local_count) занимают параметры, self и локальные переменные метода
+    std::uint32_t local_count = 0;
+};
+
+// Выбрасывается, если инструкцию нельзя перевести в байткод
+class CompileError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Компилирует программу, которую вернул ParseProgram. Переменные программы
+// хранятся в Closure, переданном при запуске
+std::unique_ptr<Chunk> CompileProgram(runtime::Executable& program);
+
+// Компилирует тело метода. Параметры метода размещаются в регистрах [0, n),
+// self - в регистре n, локальные переменные - следом за ним
+std::unique_ptr<Chunk> CompileMethod(const runtime::Method& method);
+
+// Регистровая виртуальная машина с шитым кодом
+class Machine {
+public:
+    // Выполняет скомпилированную программу, используя closure как таблицу глобальных имён
+    runtime::ObjectHolder Run(const Chunk& chunk, runtime::Closure& closure,
+                              runtime::Context& context);
+
+    // Вызывает метод method у объекта self. Если тело метода нельзя скомпилировать,
+    // вызов выполняется обходом дерева
+    runtime::ObjectHolder Invoke(runtime::ClassInstance& self, runtime::Symbol method,
+                                 std::vector<runtime::ObjectHolder> actual_args,
+                                 runtime::Context& context);
+
+private:
+    // Что вызывающий кадр делает с результатом вызова
+    enum class ResultUse : std::uint8_t {
+        // Записывает в регистр result
+        Store,
+        // Отбрасывает (вызов __init__ из NewInstance)
+        Discard,
+        // Сразу возвращает из себя (TailCall другого метода)
+        Return,
+    };
+
+    // Кадр, который ждёт возврата из вызванного метода
+    struct CallRecord {
+        const Chunk* chunk;
+        const Instruction* ip;
+        runtime::ObjectHolder* regs;
+        runtime::Closure* globals;
+        std::uint32_t result;
+        ResultUse use;
+    };
+
+    // Выполняет chunk с регистрами regs. Вызовы скомпилированных методов выполняются
+    // в том же цикле: их регистры выделяются из runtime::CallStack, а вызывающий кадр
+    // запоминается в calls_, поэтому глубина рекурсии Mython не расходует стек C++
+    runtime::ObjectHolder Execute(const Chunk& chunk, runtime::ObjectHolder* regs,
+                                  runtime::Closure* globals, runtime::Context& context);
+    const Chunk* GetMethodChunk(const runtime::Method& method);
+
+    // nullptr означает, что метод выполняется обходом дерева
+    std::unordered_map<const runtime::Method*, std::unique_ptr<Chunk>> methods_;
+    std::vector<CallRecord> calls_;
+};
+
+// Компилирует и выполняет программу. Если программу нельзя перевести в байткод,
+// она выполняется обходом дерева
+void RunProgram(runtime::Executable& program, runtime::Closure& closure,
+                runtime::Context& context);
+
+}  // namespace vm
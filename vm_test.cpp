@@ -0,0 +1,271 @@
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+#include "test_runner_p.h"
+#include "vm.h"
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+// Выполняет программу на виртуальной машине и обходом дерева,
+// проверяет, что результаты совпадают, и возвращает вывод виртуальной машины
+string RunOnBothEngines(const string& program) {
+    string vm_output;
+    {
+        istringstream is(program);
+        parse::Lexer lexer(is);
+        auto tree = ParseProgram(lexer);
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgram(*tree, closure, context);
+        vm_output = context.output.str();
+    }
+    {
+        istringstream is(program);
+        parse::Lexer lexer(is);
+        auto tree = ParseProgram(lexer);
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        tree->Execute(closure, context);
+        ASSERT_EQUAL(vm_output, context.output.str());
+    }
+    return vm_output;
+}
+
+void TestArithmetics() {
+    ASSERT_EQUAL(RunOnBothEngines("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2\n"s),
+                 "15 120 -13 3 15\n"s);
+    ASSERT_EQUAL(RunOnBothEngines("x = 'a'\ny = x + 'b'\nprint y, str(1 + 2) + x\n"s),
+                 "ab 3a\n"s);
+}
+
+// Аргумент print выводится до вычисления следующего аргумента
+void TestPrintOrder() {
+    ASSERT_EQUAL(RunOnBothEngines(R"(
+class Counter:
+  def __init__():
+    self.n = 0
+
+  def __str__():
+    return str(self.n)
+
+  def inc():
+    self.n = self.n + 1
+    return self.n
+
+c = Counter()
+print c, c.inc(), c, c.inc()
+print
+)"s),
+                 "0 1 1 2\n\n"s);
+}
+
+void TestGlobalsAreStoredInClosure() {
+    istringstream is("x = 4\ny = x * 2\n"s);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    RunProgram(*tree, closure, context);
+
+    ASSERT_EQUAL(closure.at("x"s).TryAs<runtime::Number>()->GetValue(), 4);
+    ASSERT_EQUAL(closure.at("y"s).TryAs<runtime::Number>()->GetValue(), 8);
+}
+
+void TestLogic() {
+    const string program = R"(
+a = 1
+b = 2
+c = 3
+print a + b > c and a + c > b and b + c > a
+print a < b or c < b, not a == b, a != b, a <= b, b >= c
+print "a" < "b", True == True, None == None
+)"s;
+    ASSERT_EQUAL(RunOnBothEngines(program), "False\nTrue True True True False\nTrue True True\n"s);
+}
+
+void TestClasses() {
+    const string program = R"(
+class Shape:
+  def __str__():
+    return "Shape"
+
+  def area():
+    return 0
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def area():
+    return self.w * self.h
+
+  def __str__():
+    return "Rect(" + str(self.w) + 'x' + str(self.h) + ')'
+
+class Abs:
+  def calc(n):
+    if n > 0:
+      return n
+    else:
+      return -n
+
+class GCD:
+  def __init__():
+    self.call_count = 0
+
+  def calc(a, b):
+    self.call_count = self.call_count + 1
+    if a < b:
+      return self.calc(b, a)
+    if b == 0:
+      return a
+    return self.calc(a - b, b)
+
+s = Shape()
+r = Rect(10, 20)
+print s, r, s.area(), r.area()
+x = Abs()
+print x.calc(2), x.calc(-32)
+g = GCD()
+print g.calc(510510, 18629977), g.calc(22, 17), g.call_count
+)"s;
+    ASSERT_EQUAL(RunOnBothEngines(program), "Shape Rect(10x20) 0 200\n2 32\n17 1 115\n"s);
+}
+
+void TestOperatorMethods() {
+    const string program = R"--(
+class Vec:
+  def __init__(x):
+    self.x = x
+
+  def __add__(rhs):
+    return self.x + rhs.x
+
+  def __eq__(rhs):
+    return self.x == rhs.x
+
+  def __str__():
+    return "Vec(" + str(self.x) + ")"
+
+v = Vec(Vec(1) + Vec(2))
+print v, v == Vec(3), v == Vec(4)
+)--"s;
+    ASSERT_EQUAL(RunOnBothEngines(program), "Vec(3) True False\n"s);
+}
+
+void TestRuntimeErrors() {
+    auto run = [](const string& program) {
+        istringstream is(program);
+        parse::Lexer lexer(is);
+        auto tree = ParseProgram(lexer);
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        RunProgram(*tree, closure, context);
+    };
+    ASSERT_THROWS(run("print 1 / 0\n"s), std::runtime_error);
+    ASSERT_THROWS(run("print x\n"s), std::runtime_error);
+    ASSERT_THROWS(run("print 1 + 'a'\n"s), std::runtime_error);
+    ASSERT_THROWS(run("print 1 and True\n"s), std::runtime_error);
+}
+
+// Инструкции, которых компилятор не знает, выполняются обходом дерева
+void TestFallbackToTreeWalking() {
+    struct PrintHello : ast::Statement {
+        runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override {
+            closure["hello"s] = runtime::ObjectHolder::Own(runtime::String{"hello"s});
+            context.GetOutputStream() << "hello\n"s;
+            return {};
+        }
+    };
+
+    ast::Compound program{
+        make_unique<ast::Assignment>("x"s, make_unique<ast::NumericConst>(1)),
+        make_unique<PrintHello>(),
+        ast::Print::Variable("hello"s),
+    };
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    RunProgram(program, closure, context);
+    ASSERT_EQUAL(context.output.str(), "hello\nhello\n"s);
+}
+
+void TestLoops() {
+    const string program = R"(
+class Sum:
+  def range_sum(start, stop, step):
+    total = 0
+    for i in range(start, stop, step):
+      if i == 5:
+        continue
+      total = total + i
+    return total
+
+  def first_square_above(limit):
+    k = 0
+    while True:
+      k = k + 1
+      if k * k > limit:
+        break
+    return k
+
+s = Sum()
+print s.range_sum(0, 10, 1), s.range_sum(10, 0, -2), s.range_sum(3, 3, 1), s.first_square_above(30)
+)"s;
+    ASSERT_EQUAL(RunOnBothEngines(program), "40 30 0 6\n"s);
+
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    const auto& cls = *closure.at("Sum"s).TryAs<runtime::Class>();
+    // Циклы переводятся в байткод, и методы не выполняются обходом дерева
+    ASSERT(CompileMethod(*cls.GetMethod("range_sum"s)) != nullptr);
+    ASSERT(CompileMethod(*cls.GetMethod("first_square_above"s)) != nullptr);
+}
+
+void TestLoopFallbackToTreeWalking() {
+    struct PrintHello : ast::Statement {
+        runtime::ObjectHolder Execute(runtime::Closure& /*closure*/, runtime::Context& context) override {
+            context.GetOutputStream() << "hello\n"s;
+            return {};
+        }
+    };
+
+    // Цикл с инструкцией, которую нельзя скомпилировать, целиком выполняется обходом дерева,
+    // а следующий цикл снова компилируется
+    auto loop_body = make_unique<ast::Compound>(make_unique<PrintHello>(), make_unique<ast::Break>());
+    auto counter_body = make_unique<ast::Compound>(ast::Print::Variable("i"s), make_unique<ast::Break>());
+    ast::Compound program{
+        make_unique<ast::While>(make_unique<ast::BoolConst>(true), std::move(loop_body)),
+        make_unique<ast::ForRange>("i"s, make_unique<ast::NumericConst>(0), make_unique<ast::NumericConst>(3),
+                                   make_unique<ast::NumericConst>(1), std::move(counter_body)),
+    };
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    RunProgram(program, closure, context);
+    ASSERT_EQUAL(context.output.str(), "hello\n0\n"s);
+}
+
+}  // namespace
+
+void RunVmTests(TestRunner& tr) {
+    RUN_TEST(tr, vm::TestArithmetics);
+    RUN_TEST(tr, vm::TestPrintOrder);
+    RUN_TEST(tr, vm::TestGlobalsAreStoredInClosure);
+    RUN_TEST(tr, vm::TestLogic);
+    RUN_TEST(tr, vm::TestClasses);
+    RUN_TEST(tr, vm::TestOperatorMethods);
+    RUN_TEST(tr, vm::TestRuntimeErrors);
+    RUN_TEST(tr, vm::TestFallbackToTreeWalking);
+    RUN_TEST(tr, vm::TestLoops);
+    RUN_TEST(tr, vm::TestLoopFallbackToTreeWalking);
+}
+
+}  // namespace vm